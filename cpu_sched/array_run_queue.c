@@ -0,0 +1,542 @@
+// array_run_queue.c
+#include <string.h>
+#include "scheduler.h"
+#include "array_run_queue.h"
+#include "../metrics/metrics.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define ARQ_MIN_CAP 16
+
+/**
+ * \brief Grows the arrays to twice their size and chains the new slots into
+ *        the free list. Handles stay valid.
+ *
+ * \returns `true` iff successful
+ */
+static bool arq_grow(struct array_run_queue* rq) {
+    size_t cap = rq->cap < ARQ_MIN_CAP ? ARQ_MIN_CAP : 2 * rq->cap;
+    int* pid = realloc(rq->pid, cap * sizeof(*pid));
+    if (pid) rq->pid = pid;
+    uint8_t* state = realloc(rq->state, cap * sizeof(*state));
+    if (state) rq->state = state;
+    int* runtime = realloc(rq->runtime, cap * sizeof(*runtime));
+    if (runtime) rq->runtime = runtime;
+    int* next = realloc(rq->next, cap * sizeof(*next));
+    if (next) rq->next = next;
+    int* prev = realloc(rq->prev, cap * sizeof(*prev));
+    if (prev) rq->prev = prev;
+    if (!pid || !state || !runtime || !next || !prev)
+        return false;
+
+    for (size_t i = rq->cap; i < cap; ++i) {
+        rq->pid[i] = ARQ_NO_PID;
+        rq->state[i] = ARQ_NO_STATE;
+        rq->next[i] = i + 1 < cap ? (int)i + 1 : rq->free;
+    }
+    rq->free = (int)rq->cap;
+    rq->cap = cap;
+    return true;
+}
+
+/**
+ * \brief Takes a slot from the free list and fills it in. The slot is not
+ *        linked into the queue yet.
+ *
+ * \returns The slot, -1 if out of memory
+ */
+static int arq_alloc(struct array_run_queue* rq, int pid, enum states state, int runtime) {
+    if (rq->free < 0 && !arq_grow(rq))
+        return -1;
+    int h = rq->free;
+    rq->free = rq->next[h];
+    rq->pid[h] = pid;
+    rq->state[h] = (uint8_t)state;
+    rq->runtime[h] = runtime;
+    return h;
+}
+
+/**
+ * \brief Links slot `h` in front of slot `at`, or at the tail if `at` is -1
+ */
+static void arq_link_before(struct array_run_queue* rq, int h, int at) {
+    int prev = at < 0 ? rq->tail : rq->prev[at];
+    rq->next[h] = at;
+    rq->prev[h] = prev;
+    if (prev < 0) rq->head = h;
+    else          rq->next[prev] = h;
+    if (at < 0) rq->tail = h;
+    else        rq->prev[at] = h;
+    rq->n_tasks++;
+}
+
+static void arq_unlink(struct array_run_queue* rq, int h) {
+    int prev = rq->prev[h], next = rq->next[h];
+    if (prev < 0) rq->head = next;
+    else          rq->next[prev] = next;
+    if (next < 0) rq->tail = prev;
+    else          rq->prev[next] = prev;
+    rq->n_tasks--;
+}
+
+void stud_arq_init(struct array_run_queue* rq) {
+    rq->pid = NULL;
+    rq->state = NULL;
+    rq->runtime = NULL;
+    rq->next = NULL;
+    rq->prev = NULL;
+    rq->head = rq->tail = rq->free = -1;
+    rq->n_tasks = 0;
+    rq->cap = 0;
+    rq->time_counter = 0;
+}
+
+void stud_arq_destroy(struct array_run_queue* rq) {
+    free(rq->pid);
+    free(rq->state);
+    free(rq->runtime);
+    free(rq->next);
+    free(rq->prev);
+    stud_arq_init(rq);
+}
+
+bool stud_arq_empty(struct array_run_queue const* rq) {
+    return rq->n_tasks == 0;
+}
+
+size_t stud_arq_length(struct array_run_queue const* rq) {
+    return rq->n_tasks;
+}
+
+int stud_arq_head(struct array_run_queue const* rq) {
+    return rq->head;
+}
+
+int stud_arq_tail(struct array_run_queue const* rq) {
+    return rq->tail;
+}
+
+// pids are unique, so the slot order of the scan does not matter
+int stud_arq_find(struct array_run_queue const* rq, int pid) {
+    size_t i = 0, end = rq->cap;
+#ifdef __SSE2__
+    __m128i key = _mm_set1_epi32(pid);
+    for (; i + 4 <= end; i += 4) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(rq->pid + i));
+        int m = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(v, key)));
+        if (m)
+            return (int)(i + (size_t)__builtin_ctz((unsigned)m));
+    }
+#endif
+    for (; i < end; ++i)
+        if (rq->pid[i] == pid)
+            return (int)i;
+    return -1;
+}
+
+/*
+ * Slot order is not queue order, so the vector pass only counts the matches.
+ * No match or a single one is answered from the arrays alone; with several
+ * candidates the links are walked from the head, reading only `state`.
+ */
+int stud_arq_find_state(struct array_run_queue const* rq, enum states state) {
+    size_t i = 0, end = rq->cap;
+    int count = 0, first = -1;
+#ifdef __SSE2__
+    __m128i key = _mm_set1_epi8((char)state);
+    for (; i + 16 <= end; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(rq->state + i));
+        unsigned m = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(v, key));
+        if (m && first < 0)
+            first = (int)(i + (size_t)__builtin_ctz(m));
+        count += __builtin_popcount(m);
+    }
+#endif
+    for (; i < end; ++i) {
+        if (rq->state[i] == (uint8_t)state) {
+            if (first < 0)
+                first = (int)i;
+            count++;
+        }
+    }
+    if (count <= 1)
+        return first;
+    for (int h = rq->head; h >= 0; h = rq->next[h])
+        if (rq->state[h] == (uint8_t)state)
+            return h;
+    return -1;
+}
+
+int stud_arq_enqueue(struct array_run_queue* rq, int pid, enum states state, int runtime) {
+    int h = arq_alloc(rq, pid, state, runtime);
+    if (h >= 0)
+        arq_link_before(rq, h, -1);
+    return h;
+}
+
+int stud_arq_enqueue_sorted(struct array_run_queue* rq, int pid, enum states state, int runtime) {
+    int h = arq_alloc(rq, pid, state, runtime);
+    if (h < 0)
+        return -1;
+    int at = rq->head;
+    while (at >= 0 && rq->runtime[at] <= runtime)
+        at = rq->next[at];
+    arq_link_before(rq, h, at);
+    return h;
+}
+
+int stud_arq_prepend(struct array_run_queue* rq, int pid, enum states state, int runtime) {
+    int h = arq_alloc(rq, pid, state, runtime);
+    if (h >= 0)
+        arq_link_before(rq, h, rq->head);
+    return h;
+}
+
+void stud_arq_remove(struct array_run_queue* rq, int h) {
+    arq_unlink(rq, h);
+    rq->pid[h] = ARQ_NO_PID;
+    rq->state[h] = ARQ_NO_STATE;
+    rq->next[h] = rq->free;
+    rq->free = h;
+}
+
+void stud_arq_move_to_head(struct array_run_queue* rq, int h) {
+    if (h == rq->head)
+        return;
+    arq_unlink(rq, h);
+    arq_link_before(rq, h, rq->head);
+}
+
+void stud_arq_move_to_tail(struct array_run_queue* rq, int h) {
+    if (h == rq->tail)
+        return;
+    arq_unlink(rq, h);
+    arq_link_before(rq, h, -1);
+}
+
+// ----- RR on the array run queue ----- //
+
+void stud_RR_arq_elect(struct array_run_queue* rq) {
+    int h = stud_arq_find_state(rq, READY);
+    if (h < 0)
+        return;
+    stud_arq_move_to_head(rq, h);
+    rq->state[h] = RUNNING;
+    rq->time_counter = 0;
+    METRIC_INC(CNT_CONTEXT_SWITCHES);
+    METRIC_RECORD(HIST_RUNQ_DEPTH, rq->n_tasks);
+}
+
+/**
+ * \brief Gives the head the state `state`, moves it to the BACK and elects a
+ *        new process
+ */
+static void arq_RR_requeue_head(struct array_run_queue* rq, enum states state) {
+    if (stud_arq_empty(rq))
+        return;
+    int h = rq->head;
+    rq->state[h] = (uint8_t)state;
+    stud_arq_move_to_tail(rq, h);
+    stud_RR_arq_elect(rq);
+}
+
+void stud_RR_arq(struct array_run_queue* rq, enum events event, int pid) {
+    switch(event) {
+        case start:
+            if (stud_arq_find(rq, pid) < 0)
+                stud_arq_enqueue(rq, pid, READY, 0);
+            break;
+        case terminate:
+            if (!stud_arq_empty(rq))
+                rq->runtime[rq->head] = 0;
+            arq_RR_requeue_head(rq, TERMINATED);
+            break;
+        case clock_tick:
+            if (!stud_arq_empty(rq) && ++rq->time_counter >= QUANTUM) {
+                METRIC_INC(CNT_PREEMPTIONS);
+                arq_RR_requeue_head(rq, READY);
+            }
+            break;
+        case wait:
+            arq_RR_requeue_head(rq, BLOCKED);
+            break;
+        case wake_up: {
+            int h = stud_arq_find(rq, pid);
+            if (h >= 0 && rq->state[h] == BLOCKED) {
+                rq->state[h] = READY;
+                stud_arq_move_to_tail(rq, h);
+            }
+            break;
+        }
+        default:
+            /* ignored */
+            break;
+    }
+}
+
+#ifdef ARRAY_RUN_QUEUE
+// ----- doubly_linked_list.h on pooled tasks ----- //
+//
+// The policies rewire `prev`/`next` of `struct task` themselves, so the tasks
+// keep their links, but they come from chunks of contiguous slots instead of
+// scattered malloc()s. Every run queue mirrors the pids of the tasks put on it
+// in an array next to the task pointers, and stud_rq_find compares those with
+// SSE2, so a lookup costs the length of that queue, not of the pool. A task
+// remembers the queue it was last put on (its owner) and its entry in that
+// queue's mirror. The policies unlink tasks without telling us, so an entry is
+// only trusted while its task is still owned and linked; the others are
+// dropped when the mirror fills up. Chunks are never returned to the system;
+// freed tasks go back to the pool.
+#include <pthread.h>
+#include <stdint.h>
+#include "doubly_linked_list.h"
+
+#define POOL_CHUNK 256
+#define POOL_ALIGN 32768  // chunks are aligned to this, see chunk_of()
+#define MIRROR_MIN 16
+
+struct task_chunk {
+    struct task tasks[POOL_CHUNK];
+    struct run_queue* owner[POOL_CHUNK];
+    size_t entry[POOL_CHUNK];             // index into the owner's mirror
+};
+
+_Static_assert(sizeof(struct task_chunk) <= POOL_ALIGN, "task chunk exceeds its alignment");
+
+static struct task* free_tasks;  // chained through `next`
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static struct task_chunk* chunk_of(struct task* t) {
+    return (struct task_chunk*)((uintptr_t)t & ~(uintptr_t)(POOL_ALIGN - 1));
+}
+
+static struct run_queue* owner_of(struct task* t) {
+    struct task_chunk* c = chunk_of(t);
+    return __atomic_load_n(&c->owner[t - c->tasks], __ATOMIC_RELAXED);
+}
+
+static void set_owner(struct task* t, struct run_queue* rq) {
+    struct task_chunk* c = chunk_of(t);
+    __atomic_store_n(&c->owner[t - c->tasks], rq, __ATOMIC_RELAXED);
+}
+
+static size_t* entry_of(struct task* t) {
+    struct task_chunk* c = chunk_of(t);
+    return &c->entry[t - c->tasks];
+}
+
+/**
+ * \brief Adds a chunk of free tasks to the pool. Must hold `pool_lock`.
+ */
+static bool pool_grow(void) {
+    struct task_chunk* c = aligned_alloc(POOL_ALIGN, POOL_ALIGN);
+    if (!c)
+        return false;
+    for (int i = POOL_CHUNK - 1; i >= 0; --i) {
+        c->owner[i] = NULL;
+        c->tasks[i].next = free_tasks;
+        free_tasks = &c->tasks[i];
+    }
+    return true;
+}
+
+/**
+ * \brief Whether `t`, last put on `rq`, is still linked into it. Only then
+ *        does the caller, holding `rq`, own the task's fields.
+ */
+static bool in_queue(struct run_queue* rq, struct task* t) {
+    if (owner_of(t) != rq)
+        return false;
+    return t->prev ? t->prev->next == t : rq->head == t;
+}
+
+/**
+ * \brief The task of mirror entry `i` of `rq`, or NULL if the entry is stale
+ */
+static struct task* mirror_live(struct run_queue* rq, size_t i) {
+    struct task* t = rq->slots[i];
+    if (!in_queue(rq, t) || *entry_of(t) != i)
+        return NULL;
+    return t;
+}
+
+/**
+ * \brief Drops the stale entries of the mirror of `rq`
+ */
+static void mirror_compact(struct run_queue* rq) {
+    size_t n = 0;
+    for (size_t i = 0; i < rq->n_slots; ++i) {
+        struct task* t = mirror_live(rq, i);
+        if (!t) continue;
+        rq->pids[n] = rq->pids[i];
+        rq->slots[n] = t;
+        *entry_of(t) = n++;
+    }
+    rq->n_slots = n;
+}
+
+/**
+ * \brief Makes `task` owned by `rq` and gives it an entry in the mirror of
+ *        `rq`, keeping the one it still has there
+ * \return false if the mirror could not grow; `task` is left as it was
+ */
+static bool mirror_add(struct run_queue* rq, struct task* task) {
+    size_t i = *entry_of(task);
+    if (owner_of(task) == rq && i < rq->n_slots && rq->slots[i] == task)
+        return true;
+    if (rq->n_slots == rq->cap_slots) {
+        mirror_compact(rq);
+        // grow unless compacting freed half of it, so compactions stay amortized
+        if (rq->n_slots * 2 >= rq->cap_slots) {
+            size_t cap = rq->cap_slots ? rq->cap_slots * 2 : MIRROR_MIN;
+            int* pids = realloc(rq->pids, cap * sizeof(*pids));
+            if (!pids) return false;
+            rq->pids = pids;
+            struct task** slots = realloc(rq->slots, cap * sizeof(*slots));
+            if (!slots) return false;
+            rq->slots = slots;
+            rq->cap_slots = cap;
+        }
+    }
+    rq->pids[rq->n_slots] = task->pid;
+    rq->slots[rq->n_slots] = task;
+    *entry_of(task) = rq->n_slots++;
+    set_owner(task, rq);
+    return true;
+}
+
+bool stud_rq_empty(struct run_queue const *rq) {
+    return rq->n_tasks == 0;
+}
+
+struct task *stud_task_create(int pid, enum states state) {
+    pthread_mutex_lock(&pool_lock);
+    struct task *t = free_tasks;
+    if (!t && pool_grow())
+        t = free_tasks;
+    if (t)
+        free_tasks = t->next;
+    pthread_mutex_unlock(&pool_lock);
+    if (!t) return NULL;
+
+    t->pid = pid;
+    t->state = state;
+    t->prev = t->next = NULL;
+    t->runtime = 0;
+    t->level = 0;
+    t->affinity = UINT64_MAX;
+    t->burst = 0;
+    t->predicted = INITIAL_BURST;
+    return t;
+}
+
+void stud_task_free(struct task *task) {
+    if (!task) return;
+    set_owner(task, NULL);
+    pthread_mutex_lock(&pool_lock);
+    task->next = free_tasks;
+    free_tasks = task;
+    pthread_mutex_unlock(&pool_lock);
+}
+
+void stud_rq_destroy(struct run_queue *rq) {
+    struct task *cur = rq->head;
+    while (cur) {
+        struct task *next = cur->next;
+        stud_task_free(cur);
+        cur = next;
+    }
+    free(rq->pids);
+    free(rq->slots);
+    *rq = (struct run_queue){ .head = NULL };
+}
+
+struct task *stud_rq_find(struct run_queue *rq, int pid) {
+    size_t i = 0;
+#ifdef __SSE2__
+    __m128i key = _mm_set1_epi32(pid);
+    for (; i + 4 <= rq->n_slots; i += 4) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(rq->pids + i));
+        unsigned m = (unsigned)_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(v, key)));
+        for (; m; m &= m - 1) {
+            struct task* t = mirror_live(rq, i + (size_t)__builtin_ctz(m));
+            if (t)
+                return t;
+        }
+    }
+#endif
+    for (; i < rq->n_slots; ++i) {
+        struct task* t = rq->pids[i] == pid ? mirror_live(rq, i) : NULL;
+        if (t)
+            return t;
+    }
+    return NULL;
+}
+
+struct task *stud_rq_head(struct run_queue *rq) {
+    return rq->head;
+}
+
+struct task *stud_rq_tail(struct run_queue *rq) {
+    struct task *cur = rq->tail;
+    if (cur && in_queue(rq, cur) && !cur->next)
+        return cur;
+    // the policies unlinked or moved the cached tail
+    cur = rq->head;
+    if (!cur) return NULL;
+    while (cur->next)
+        cur = cur->next;
+    return rq->tail = cur;
+}
+
+bool stud_rq_enqueue(struct run_queue *rq, struct task *task) {
+    if (!rq || !task) return false;
+    struct task *tail = stud_rq_tail(rq);
+    if (!mirror_add(rq, task)) return false;
+    task->prev = tail;
+    task->next = NULL;
+    if (tail) tail->next = task;
+    else      rq->head = task;
+    rq->tail = task;
+    rq->n_tasks++;
+    return true;
+}
+
+bool stud_rq_enqueue_sorted(struct run_queue* rq, struct task* task) {
+    if (!rq || !task) return false;
+    if (!mirror_add(rq, task)) return false;
+    struct task *cur = rq->head, *last = NULL;
+    while (cur && cur->runtime <= task->runtime) {
+        last = cur;
+        cur = cur->next;
+    }
+    task->next = cur;
+    task->prev = last;
+    if (last) last->next = task;
+    else      rq->head = task;
+    if (cur) cur->prev = task;
+    else     rq->tail = task;
+    rq->n_tasks++;
+    return true;
+}
+
+bool stud_rq_prepend(struct run_queue *rq, struct task *task) {
+    if (!rq || !task) return false;
+    if (!mirror_add(rq, task)) return false;
+    task->prev = NULL;
+    task->next = rq->head;
+    if (rq->head)
+        rq->head->prev = task;
+    else
+        rq->tail = task;
+    rq->head = task;
+    rq->n_tasks++;
+    return true;
+}
+
+size_t stud_rq_length(struct run_queue *rq) {
+    return rq->n_tasks;
+}
+#endif // ARRAY_RUN_QUEUE
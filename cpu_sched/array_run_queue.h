@@ -0,0 +1,129 @@
+#ifndef ARRAY_RUN_QUEUE_H__
+#define ARRAY_RUN_QUEUE_H__
+
+#include "scheduler.h"
+
+/*
+ * Run queue in structure-of-arrays form. A task is a slot: its pid, state
+ * and runtime sit at the same index of contiguous arrays, and `next`/`prev`
+ * hold the indices of its neighbours (-1 at the ends). The slot index is the
+ * handle of a task; it stays valid until the task is removed. Free slots are
+ * chained through `next` and carry ARQ_NO_PID and ARQ_NO_STATE, so find and
+ * find_state can compare every slot with SSE2 without looking at the links.
+ *
+ * Built with -DARRAY_RUN_QUEUE, this file also provides the stud_task_* and
+ * stud_rq_* functions of doubly_linked_list.h (see the end of
+ * array_run_queue.c), so every policy runs on pooled tasks unchanged.
+ */
+
+#define ARQ_NO_PID   INT32_MIN
+#define ARQ_NO_STATE 0xff
+
+struct array_run_queue {
+    int* pid;
+    uint8_t* state;  // enum states
+    int* runtime;
+    int* next;
+    int* prev;
+    int head, tail;  // -1 if empty
+    int free;        // first free slot, -1 if none
+    size_t n_tasks;
+    size_t cap;
+    int time_counter;
+};
+
+/**
+ * \brief Initializes an empty run queue
+ */
+void stud_arq_init(struct array_run_queue* rq);
+
+/**
+ * \brief Frees the arrays of the run queue and empties it. `rq` itself is not
+ *        freed.
+ */
+void stud_arq_destroy(struct array_run_queue* rq);
+
+/**
+ * \brief Checks whether the run queue is empty
+ */
+bool stud_arq_empty(struct array_run_queue const* rq);
+
+/**
+ * \brief Computes the length of the run queue
+ */
+size_t stud_arq_length(struct array_run_queue const* rq);
+
+/**
+ * \brief Returns the handle of the head, -1 if the queue is empty
+ */
+int stud_arq_head(struct array_run_queue const* rq);
+
+/**
+ * \brief Returns the handle of the tail, -1 if the queue is empty
+ */
+int stud_arq_tail(struct array_run_queue const* rq);
+
+/**
+ * \brief Tries to find a task by its PID
+ *
+ * \returns Handle of the task, -1 if failed
+ */
+int stud_arq_find(struct array_run_queue const* rq, int pid);
+
+/**
+ * \brief Finds the first task (closest to the head) in state `state`
+ *
+ * \returns Handle of the task, -1 if failed
+ */
+int stud_arq_find_state(struct array_run_queue const* rq, enum states state);
+
+/**
+ * \brief Enqueues a new task at the END of the queue
+ *
+ * \returns Handle of the task, -1 if out of memory
+ */
+int stud_arq_enqueue(struct array_run_queue* rq, int pid, enum states state, int runtime);
+
+/**
+ * \brief Enqueues a new task sorted by ascending runtime, behind all tasks
+ *        with the same runtime
+ *
+ * \returns Handle of the task, -1 if out of memory
+ */
+int stud_arq_enqueue_sorted(struct array_run_queue* rq, int pid, enum states state, int runtime);
+
+/**
+ * \brief Prepends a new task, it becomes the head
+ *
+ * \returns Handle of the task, -1 if out of memory
+ */
+int stud_arq_prepend(struct array_run_queue* rq, int pid, enum states state, int runtime);
+
+/**
+ * \brief Removes the task at handle `h`, its slot becomes free
+ */
+void stud_arq_remove(struct array_run_queue* rq, int h);
+
+/**
+ * \brief Moves the task at handle `h` to the head in O(1)
+ */
+void stud_arq_move_to_head(struct array_run_queue* rq, int h);
+
+/**
+ * \brief Moves the task at handle `h` to the tail in O(1)
+ */
+void stud_arq_move_to_tail(struct array_run_queue* rq, int h);
+
+/**
+ * \brief Elects the first READY task and moves it to the head. Same semantics
+ *        as stud_RR_elect.
+ */
+void stud_RR_arq_elect(struct array_run_queue* rq);
+
+/**
+ * \brief Event handler for RR on top of the array run queue. Same semantics as
+ *        stud_RR.
+ */
+void stud_RR_arq(struct array_run_queue* rq, enum events event, int pid);
+
+#endif // ARRAY_RUN_QUEUE_H__
@@ -4,6 +4,9 @@
 #include "scheduler.h"
 #include "doubly_linked_list.h"
 
+// -DARRAY_RUN_QUEUE: array_run_queue.c provides these on pooled tasks
+#ifndef ARRAY_RUN_QUEUE
+
 /**
  * \brief Checks whether a run_queue is empty
  *
@@ -30,6 +33,10 @@ struct task *stud_task_create(int pid, enum states state) {
     t->state = state;
     t->prev = t->next = NULL;
     t->runtime = 0;
+    t->level = 0;
+    t->affinity = UINT64_MAX;
+    t->burst = 0;
+    t->predicted = INITIAL_BURST;
     return t;
 }
 
@@ -188,3 +195,4 @@ bool stud_rq_prepend(struct run_queue *rq, struct task *task) {
 size_t stud_rq_length(struct run_queue *rq) {
     return rq->n_tasks;
 }
+#endif // ARRAY_RUN_QUEUE
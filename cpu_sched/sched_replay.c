@@ -0,0 +1,464 @@
+// sched_replay.c
+//
+// Replays a recorded event log against one of the scheduling policies and
+// reports per-task turnaround, waiting and response time, context switches,
+// throughput and the scheduler's own cost per event.
+//
+// usage: sched_replay <policy> [trace|-] [-v]
+//
+// The trace has one event per line: `<event> <pid>`, where <event> is one of
+// start, wait, wake_up, terminate, clock_tick or its numeric value from
+// `enum events`. The pid of wait, terminate and clock_tick is ignored. Lines
+// with a pid of MAX_PID or more count as unparsable. Lines starting with '#'
+// are skipped. Regular files are mmap'ed, everything else
+// (e.g. `-` for stdin) is streamed.
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include "scheduler.h"
+#include "scheduler_round_robin.h"
+#include "scheduler_sjf.h"
+#include "scheduler_mlfq.h"
+#include "scheduler_srtf.h"
+#include "scheduler_rr_adaptive.h"
+#include "array_run_queue.h"
+#include "doubly_linked_list.h"
+
+#define N_EVENTS (clock_tick + 1)
+#define MAX_PID  (1 << 24)
+
+struct policy {
+    const char* name;
+    void* (*create)(void);
+    void (*handle)(void* sched, enum events event, int pid);
+    int (*running)(void* sched);  // pid on the CPU, -1 if idle
+    void (*destroy)(void* sched);
+};
+
+// ----- policies ----- //
+
+static void* rq_create(void) {
+    return calloc(1, sizeof(struct run_queue));
+}
+
+static int rq_running(void* sched) {
+    struct task* t = stud_rq_head(sched);
+    return t && t->state == RUNNING ? t->pid : -1;
+}
+
+static void rq_destroy(void* sched) {
+    stud_rq_destroy(sched);
+    free(sched);
+}
+
+// RR and SJF only elect after a quantum expiry, a terminate or a wait. The
+// replay elects whenever the CPU is idle after an event, like an idle loop.
+static void rr_handle(void* sched, enum events event, int pid) {
+    stud_RR(sched, event, pid);
+    if (rq_running(sched) < 0)
+        stud_RR_elect(sched);
+}
+
+static void sjf_handle(void* sched, enum events event, int pid) {
+    stud_SJF(sched, event, pid);
+    if (rq_running(sched) < 0)
+        stud_SJF_elect(sched);
+}
+
+static void srtf_handle(void* sched, enum events event, int pid) {
+    stud_SRTF(sched, event, pid);
+}
+
+static void* arr_create(void) {
+    struct rr_adaptive* arr = malloc(sizeof(*arr));
+    if (arr) stud_ARR_init(arr);
+    return arr;
+}
+
+static void arr_handle(void* sched, enum events event, int pid) {
+    struct rr_adaptive* arr = sched;
+    stud_ARR(arr, event, pid);
+    if (rq_running(&arr->rq) < 0)
+        stud_RR_elect(&arr->rq);
+}
+
+static void* arq_create(void) {
+    struct array_run_queue* rq = malloc(sizeof(*rq));
+    if (rq) stud_arq_init(rq);
+    return rq;
+}
+
+static int arq_running(void* sched) {
+    struct array_run_queue* rq = sched;
+    int h = stud_arq_head(rq);
+    return h >= 0 && rq->state[h] == RUNNING ? rq->pid[h] : -1;
+}
+
+static void arq_handle(void* sched, enum events event, int pid) {
+    stud_RR_arq(sched, event, pid);
+    if (arq_running(sched) < 0)
+        stud_RR_arq_elect(sched);
+}
+
+static void arq_destroy(void* sched) {
+    stud_arq_destroy(sched);
+    free(sched);
+}
+
+static void* mlfq_create(void) {
+    struct mlfq* q = malloc(sizeof(*q));
+    if (q) stud_MLFQ_init(q);
+    return q;
+}
+
+static void mlfq_handle(void* sched, enum events event, int pid) {
+    stud_MLFQ(sched, event, pid);
+}
+
+static int mlfq_running(void* sched) {
+    struct task* t = stud_MLFQ_running(sched);
+    return t ? t->pid : -1;
+}
+
+static void mlfq_destroy(void* sched) {
+    stud_MLFQ_destroy(sched);
+    free(sched);
+}
+
+static const struct policy policies[] = {
+    { "rr",   rq_create,   rr_handle,   rq_running,   rq_destroy   },
+    { "sjf",  rq_create,   sjf_handle,  rq_running,   rq_destroy   },
+    { "srtf", rq_create,   srtf_handle, rq_running,   rq_destroy   },
+    { "arr",  arr_create,  arr_handle,  rq_running,   rq_destroy   },
+    { "rr-arq", arq_create, arq_handle, arq_running, arq_destroy },
+    { "mlfq", mlfq_create, mlfq_handle, mlfq_running, mlfq_destroy },
+};
+
+// ----- metrics ----- //
+
+struct task_stats {
+    bool seen;
+    bool blocked;
+    bool done;
+    long arrival;
+    long first_run;     // -1 until the task is dispatched for the first time
+    long completion;
+    long run;           // ticks on the CPU
+    long blocked_total; // ticks in BLOCKED
+    long blocked_since;
+};
+
+struct replay {
+    const struct policy* policy;
+    void* sched;
+
+    struct task_stats* tasks;
+    size_t cap;
+
+    long now;           // number of clock ticks so far
+    int last_running;   // last dispatched pid
+    unsigned long events;
+    unsigned long switches;
+    unsigned long bad_lines;
+
+    long long handler_ns[N_EVENTS];
+    unsigned long handler_calls[N_EVENTS];
+    long long timer_overhead_ns;
+};
+
+static struct task_stats* stats_get(struct replay* r, int pid) {
+    if (pid < 0 || pid >= MAX_PID)
+        return NULL;
+    if ((size_t)pid >= r->cap) {
+        size_t cap = r->cap ? r->cap : 1024;
+        while (cap <= (size_t)pid)
+            cap *= 2;
+        struct task_stats* t = realloc(r->tasks, cap * sizeof(*t));
+        if (!t)
+            return NULL;
+        memset(t + r->cap, 0, (cap - r->cap) * sizeof(*t));
+        r->tasks = t;
+        r->cap = cap;
+    }
+    return &r->tasks[pid];
+}
+
+static long long now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static long long timer_overhead(void) {
+    long long best = -1;
+    for (int i = 0; i < 1000; ++i) {
+        long long a = now_ns(), b = now_ns();
+        if (best < 0 || b - a < best)
+            best = b - a;
+    }
+    return best;
+}
+
+/**
+ * \brief Feeds one event to the policy and updates the per-task statistics
+ */
+static void replay_event(struct replay* r, enum events event, int pid) {
+    int running = r->policy->running(r->sched);
+    struct task_stats* cur = running >= 0 ? stats_get(r, running) : NULL;
+
+    switch (event) {
+        case start: {
+            struct task_stats* t = stats_get(r, pid);
+            if (t && !t->seen) {
+                memset(t, 0, sizeof(*t));
+                t->seen = true;
+                t->arrival = r->now;
+                t->first_run = -1;
+            }
+            break;
+        }
+        case wait:
+            if (cur) {
+                cur->blocked = true;
+                cur->blocked_since = r->now;
+            }
+            break;
+        case wake_up: {
+            struct task_stats* t = stats_get(r, pid);
+            if (t && t->blocked) {
+                t->blocked = false;
+                t->blocked_total += r->now - t->blocked_since;
+            }
+            break;
+        }
+        case terminate:
+            if (cur) {
+                cur->done = true;
+                cur->completion = r->now;
+            }
+            break;
+        case clock_tick:
+            if (cur)
+                cur->run++;
+            r->now++;
+            break;
+    }
+
+    // terminate and wait act on the running task; on an idle CPU there is none
+    if (running >= 0 || (event != terminate && event != wait)) {
+        long long t0 = now_ns();
+        r->policy->handle(r->sched, event, pid);
+        long long t1 = now_ns();
+        r->handler_ns[event] += t1 - t0 - r->timer_overhead_ns;
+        r->handler_calls[event]++;
+    }
+    r->events++;
+
+    running = r->policy->running(r->sched);
+    if (running >= 0) {
+        if (running != r->last_running) {
+            if (r->last_running >= 0)
+                r->switches++;
+            r->last_running = running;
+        }
+        struct task_stats* t = stats_get(r, running);
+        if (t && t->first_run < 0)
+            t->first_run = r->now;
+    }
+}
+
+// ----- trace parsing ----- //
+
+static const char* event_names[N_EVENTS] = {
+    "start", "wait", "wake_up", "terminate", "clock_tick",
+};
+
+/**
+ * \brief Parses one line `[p, end)` and replays it
+ */
+static void replay_line(struct replay* r, const char* p, const char* end) {
+    while (p < end && (*p == ' ' || *p == '\t'))
+        ++p;
+    if (p == end || *p == '#' || *p == '\r')
+        return;
+
+    const char* word = p;
+    while (p < end && *p != ' ' && *p != '\t' && *p != '\r')
+        ++p;
+    size_t len = (size_t)(p - word);
+
+    int event = -1;
+    if (len == 1 && *word >= '0' && *word < '0' + N_EVENTS) {
+        event = *word - '0';
+    } else {
+        for (int e = 0; e < N_EVENTS; ++e)
+            if (strlen(event_names[e]) == len && !memcmp(word, event_names[e], len))
+                event = e;
+    }
+
+    while (p < end && (*p == ' ' || *p == '\t'))
+        ++p;
+    int pid = 0;
+    bool neg = p < end && *p == '-';
+    if (neg) ++p;
+    // stops growing at MAX_PID, so it cannot overflow
+    for (; p < end && *p >= '0' && *p <= '9'; ++p)
+        if (pid < MAX_PID)
+            pid = pid * 10 + (*p - '0');
+
+    if (event < 0 || pid >= MAX_PID) {
+        r->bad_lines++;
+        return;
+    }
+    replay_event(r, (enum events)event, neg ? -pid : pid);
+}
+
+static int replay_mmap(struct replay* r, int fd, size_t size) {
+    if (size == 0)
+        return 0;
+    const char* data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED)
+        return -1;
+    madvise((void*)data, size, MADV_SEQUENTIAL);
+    const char* p = data;
+    const char* end = data + size;
+    while (p < end) {
+        const char* nl = memchr(p, '\n', (size_t)(end - p));
+        if (!nl) nl = end;
+        replay_line(r, p, nl);
+        p = nl + 1;
+    }
+    munmap((void*)data, size);
+    return 0;
+}
+
+static int replay_stream(struct replay* r, FILE* in) {
+    char* line = NULL;
+    size_t cap = 0;
+    ssize_t n;
+    while ((n = getline(&line, &cap, in)) > 0)
+        replay_line(r, line, line + n - (line[n - 1] == '\n'));
+    free(line);
+    return ferror(in) ? -1 : 0;
+}
+
+// ----- report ----- //
+
+static void report(struct replay* r, bool verbose) {
+    unsigned long done = 0, unfinished = 0;
+    double turnaround = 0, waiting = 0, response = 0;
+    long max_turnaround = 0, max_waiting = 0, max_response = 0;
+
+    if (verbose)
+        printf("%8s %8s %8s %8s %8s %8s\n", "pid", "arrival", "turnaround",
+               "waiting", "response", "run");
+    for (size_t pid = 0; pid < r->cap; ++pid) {
+        struct task_stats* t = &r->tasks[pid];
+        if (!t->seen)
+            continue;
+        if (!t->done) {
+            unfinished++;
+            continue;
+        }
+        long ta = t->completion - t->arrival;
+        long wt = ta - t->run - t->blocked_total;
+        long rt = t->first_run >= 0 ? t->first_run - t->arrival : ta;
+        if (verbose)
+            printf("%8zu %8ld %10ld %8ld %8ld %8ld\n", pid, t->arrival, ta, wt, rt, t->run);
+        done++;
+        turnaround += (double)ta;
+        waiting += (double)wt;
+        response += (double)rt;
+        if (ta > max_turnaround) max_turnaround = ta;
+        if (wt > max_waiting)    max_waiting = wt;
+        if (rt > max_response)   max_response = rt;
+    }
+
+    printf("policy           %s\n", r->policy->name);
+    printf("events           %lu (%lu unparsable lines)\n", r->events, r->bad_lines);
+    printf("clock ticks      %ld\n", r->now);
+    printf("completed tasks  %lu (%lu unfinished)\n", done, unfinished);
+    if (done) {
+        printf("turnaround       avg %.2f  max %ld\n", turnaround / (double)done, max_turnaround);
+        printf("waiting          avg %.2f  max %ld\n", waiting / (double)done, max_waiting);
+        printf("response         avg %.2f  max %ld\n", response / (double)done, max_response);
+    }
+    printf("context switches %lu\n", r->switches);
+    if (r->now)
+        printf("throughput       %.3f tasks / 1000 ticks\n", 1000.0 * (double)done / (double)r->now);
+
+    long long total_ns = 0;
+    unsigned long calls = 0;
+    for (int e = 0; e < N_EVENTS; ++e) {
+        total_ns += r->handler_ns[e];
+        calls += r->handler_calls[e];
+    }
+    if (calls)
+        printf("scheduler cost   %.1f ns/event\n", (double)total_ns / (double)calls);
+    for (int e = 0; e < N_EVENTS; ++e)
+        if (r->handler_calls[e])
+            printf("  %-12s   %.1f ns (%lu calls)\n", event_names[e],
+                   (double)r->handler_ns[e] / (double)r->handler_calls[e], r->handler_calls[e]);
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <rr|sjf|srtf|arr|rr-arq|mlfq> [trace|-] [-v]\n", argv[0]);
+        return 1;
+    }
+
+    struct replay r = { 0 };
+    r.last_running = -1;
+    for (size_t i = 0; i < sizeof(policies) / sizeof(policies[0]); ++i)
+        if (!strcmp(argv[1], policies[i].name))
+            r.policy = &policies[i];
+    if (!r.policy) {
+        fprintf(stderr, "unknown policy '%s'\n", argv[1]);
+        return 1;
+    }
+
+    const char* path = argc > 2 ? argv[2] : "-";
+    bool verbose = argc > 3 && !strcmp(argv[3], "-v");
+
+    r.sched = r.policy->create();
+    if (!r.sched) {
+        perror("create");
+        return 1;
+    }
+    r.timer_overhead_ns = timer_overhead();
+
+    int rc;
+    if (!strcmp(path, "-")) {
+        rc = replay_stream(&r, stdin);
+    } else {
+        int fd = open(path, O_RDONLY);
+        struct stat st;
+        if (fd == -1 || fstat(fd, &st) == -1) {
+            perror(path);
+            return 1;
+        }
+        if (S_ISREG(st.st_mode)) {
+            rc = replay_mmap(&r, fd, (size_t)st.st_size);
+        } else {
+            FILE* in = fdopen(fd, "r");
+            rc = in ? replay_stream(&r, in) : -1;
+            if (in) fclose(in);
+            fd = -1;
+        }
+        if (fd != -1)
+            close(fd);
+    }
+    if (rc == -1) {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        return 1;
+    }
+
+    report(&r, verbose);
+    r.policy->destroy(r.sched);
+    free(r.tasks);
+    return 0;
+}
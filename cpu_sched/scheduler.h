@@ -5,9 +5,13 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 #define QUANTUM 10
 
+// Burst prediction of a task that has not blocked yet
+#define INITIAL_BURST QUANTUM
+
 enum states {
     BLOCKED = 0,
     RUNNING,
@@ -29,12 +33,24 @@ struct task {
     struct task* prev;
     struct task* next;
     int runtime;
+    int level;
+    uint64_t affinity; // bit i set iff the task may run on CPU i
+    int burst;         // ticks on the CPU since the last wait
+    int predicted;     // predicted length of the next CPU burst
 };
 
 struct run_queue {
     struct task* head;
     size_t n_tasks;
     int time_counter;
+#ifdef ARRAY_RUN_QUEUE
+    // pid mirror and cached tail, see array_run_queue.c; zero-initialize
+    // run queues in this build
+    int* pids;
+    struct task** slots;
+    size_t n_slots, cap_slots;
+    struct task* tail;
+#endif
 };
 
 #endif // SCHEDULER_H__
@@ -0,0 +1,251 @@
+// scheduler_mlfq.c
+#include "scheduler.h"
+#include "scheduler_mlfq.h"
+#include "doubly_linked_list.h"
+#include "../metrics/metrics.h"
+
+/* Quantum of each level; level 1 matches the RR quantum */
+static const int mlfq_quantum[MLFQ_LEVELS] = {
+    QUANTUM / 2, QUANTUM, 2 * QUANTUM, 4 * QUANTUM,
+};
+
+/**
+ * \brief Removes `t` from `rq` without freeing it
+ *
+ * \param rq The run_queue containing `t`
+ * \param t  The task to be removed
+ */
+static void mlfq_unlink(struct run_queue* rq, struct task* t) {
+    if (t->prev) t->prev->next = t->next;
+    else         rq->head = t->next;
+    if (t->next) t->next->prev = t->prev;
+    t->prev = t->next = NULL;
+    rq->n_tasks--;
+}
+
+/**
+ * \brief Puts a READY task at the back of its level
+ *
+ * \param q The scheduler
+ * \param t The task to be enqueued
+ */
+static void mlfq_enqueue(struct mlfq* q, struct task* t) {
+    t->state = READY;
+    stud_rq_enqueue(&q->levels[t->level], t);
+    q->bitmap |= 1u << t->level;
+}
+
+/**
+ * \brief Number of READY tasks over all levels
+ */
+static inline size_t mlfq_queued(struct mlfq const* q) {
+    size_t n = 0;
+    for (int lvl = 0; lvl < MLFQ_LEVELS; ++lvl)
+        n += q->levels[lvl].n_tasks;
+    return n;
+}
+
+/**
+ * \brief Elects the first task of the highest non-empty level. The running
+ *        task (if any) must have been taken off the CPU before.
+ *
+ * \param q The scheduler
+ */
+static void mlfq_elect(struct mlfq* q) {
+    q->running = NULL;
+    if (!q->bitmap)
+        return;
+    METRIC_RECORD(HIST_RUNQ_DEPTH, mlfq_queued(q));
+    int lvl = __builtin_ctz(q->bitmap);
+    struct run_queue* rq = &q->levels[lvl];
+    struct task* t = rq->head;
+    mlfq_unlink(rq, t);
+    if (stud_rq_empty(rq))
+        q->bitmap &= ~(1u << lvl);
+    t->state = RUNNING;
+    q->running = t;
+    METRIC_INC(CNT_CONTEXT_SWITCHES);
+}
+
+/**
+ * \brief Preempts the running task if a task of a higher priority is READY.
+ *        The preempted task goes back to the FRONT of its level and keeps
+ *        the ticks it already used.
+ *
+ * \param q The scheduler
+ */
+static void mlfq_check_preempt(struct mlfq* q) {
+    struct task* cur = q->running;
+    if (!cur) {
+        mlfq_elect(q);
+        return;
+    }
+    if (!q->bitmap || __builtin_ctz(q->bitmap) >= cur->level)
+        return;
+    METRIC_INC(CNT_PREEMPTIONS);
+    cur->state = READY;
+    stud_rq_prepend(&q->levels[cur->level], cur);
+    q->bitmap |= 1u << cur->level;
+    mlfq_elect(q);
+}
+
+/**
+ * \brief Moves every task back to level 0
+ *
+ * \param q The scheduler
+ */
+static void mlfq_boost(struct mlfq* q) {
+    for (int lvl = 1; lvl < MLFQ_LEVELS; ++lvl) {
+        struct run_queue* rq = &q->levels[lvl];
+        while (rq->head) {
+            struct task* t = rq->head;
+            mlfq_unlink(rq, t);
+            t->level = 0;
+            t->runtime = 0;
+            mlfq_enqueue(q, t);
+        }
+    }
+    q->bitmap &= 1u;
+    for (struct task* t = q->blocked.head; t; t = t->next) {
+        t->level = 0;
+        t->runtime = 0;
+    }
+    if (q->running) {
+        q->running->level = 0;
+        q->running->runtime = 0;
+    }
+    q->boost_counter = 0;
+}
+
+/**
+ * \brief Searches `pid` in all levels, the blocked queue and on the CPU
+ *
+ * \param q   The scheduler
+ * \param pid PID of the wanted task
+ *
+ * \returns Pointer to the task, `NULL` if failed
+ */
+static struct task* mlfq_find(struct mlfq* q, int pid) {
+    if (q->running && q->running->pid == pid)
+        return q->running;
+    struct task* t = stud_rq_find(&q->blocked, pid);
+    for (int lvl = 0; !t && lvl < MLFQ_LEVELS; ++lvl)
+        t = stud_rq_find(&q->levels[lvl], pid);
+    return t;
+}
+
+void stud_MLFQ_init(struct mlfq* q) {
+    for (int lvl = 0; lvl < MLFQ_LEVELS; ++lvl)
+        q->levels[lvl] = (struct run_queue){ .head = NULL };
+    q->blocked = (struct run_queue){ .head = NULL };
+    q->running = NULL;
+    q->bitmap = 0;
+    q->boost_counter = 0;
+}
+
+void stud_MLFQ_destroy(struct mlfq* q) {
+    for (int lvl = 0; lvl < MLFQ_LEVELS; ++lvl)
+        stud_rq_destroy(&q->levels[lvl]);
+    stud_rq_destroy(&q->blocked);
+    stud_task_free(q->running);
+    q->running = NULL;
+    q->bitmap = 0;
+}
+
+struct task* stud_MLFQ_running(struct mlfq* q) {
+    return q->running;
+}
+
+/**
+ * \brief Enqueues a new process in READY state on level 0
+ *
+ * \param q   The scheduler
+ * \param pid The process to be enqueued
+ */
+void stud_MLFQ_start(struct mlfq* q, int pid) {
+    if (mlfq_find(q, pid))
+        return;
+    struct task* t = stud_task_create(pid, READY);
+    if (!t) return;
+    mlfq_enqueue(q, t);
+    mlfq_check_preempt(q);
+}
+
+/**
+ * \brief Terminates and frees the running process, then elects a new one.
+ *
+ * \param q The scheduler
+ */
+void stud_MLFQ_terminate(struct mlfq* q) {
+    if (!q->running)
+        return;
+    stud_task_free(q->running);
+    mlfq_elect(q);
+}
+
+/**
+ * \brief Performs a clock tick. A task that used up the quantum of its level
+ *        is demoted by one level. Every MLFQ_BOOST_PERIOD ticks all tasks are
+ *        boosted back to level 0.
+ *
+ * \param q The scheduler
+ */
+void stud_MLFQ_clock_tick(struct mlfq* q) {
+    struct task* t = q->running;
+    if (t && ++t->runtime >= mlfq_quantum[t->level]) {
+        METRIC_INC(CNT_PREEMPTIONS);
+        if (t->level < MLFQ_LEVELS - 1)
+            t->level++;
+        t->runtime = 0;
+        mlfq_enqueue(q, t);
+        mlfq_elect(q);
+    }
+    if (++q->boost_counter >= MLFQ_BOOST_PERIOD)
+        mlfq_boost(q);
+    mlfq_check_preempt(q);
+}
+
+/**
+ * \brief Blocks the running process and elects a new one.
+ *
+ * \param q The scheduler
+ */
+void stud_MLFQ_wait(struct mlfq* q) {
+    struct task* t = q->running;
+    if (!t)
+        return;
+    t->state = BLOCKED;
+    stud_rq_enqueue(&q->blocked, t);
+    mlfq_elect(q);
+}
+
+/**
+ * \brief Sets the state of `pid` to READY, if it is blocked, and promotes it
+ *        by one level. Preempts the running process if `pid` now has a
+ *        higher priority.
+ *
+ * \param q   The scheduler
+ * \param pid The process to be woken up
+ */
+void stud_MLFQ_wake_up(struct mlfq* q, int pid) {
+    struct task* t = stud_rq_find(&q->blocked, pid);
+    if (!t)
+        return;
+    mlfq_unlink(&q->blocked, t);
+    if (t->level > 0)
+        t->level--;
+    t->runtime = 0;
+    mlfq_enqueue(q, t);
+    mlfq_check_preempt(q);
+}
+
+void stud_MLFQ(struct mlfq* q, enum events event, int pid) {
+    switch(event) {
+        case start:      stud_MLFQ_start(q, pid);     break;
+        case terminate:  stud_MLFQ_terminate(q);      break;
+        case clock_tick: stud_MLFQ_clock_tick(q);     break;
+        case wait:       stud_MLFQ_wait(q);           break;
+        case wake_up:    stud_MLFQ_wake_up(q, pid);   break;
+        default:         /* ignored */                break;
+    }
+}
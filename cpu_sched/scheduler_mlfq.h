@@ -0,0 +1,57 @@
+#ifndef SCHEDULER_MLFQ_H__
+#define SCHEDULER_MLFQ_H__
+
+#include "scheduler.h"
+
+// Number of priority levels, level 0 is the highest priority
+#define MLFQ_LEVELS 4
+
+// Every MLFQ_BOOST_PERIOD clock ticks all tasks are moved back to level 0
+#define MLFQ_BOOST_PERIOD 100
+
+struct mlfq {
+    struct run_queue levels[MLFQ_LEVELS]; // READY tasks of each level
+    struct run_queue blocked;             // BLOCKED tasks
+    struct task* running;
+    unsigned int bitmap;                  // bit i set iff levels[i] is non-empty
+    int boost_counter;
+};
+
+/**
+ * \brief Initializes an empty MLFQ scheduler
+ *
+ * \param q The scheduler to be initialized
+ */
+void stud_MLFQ_init(struct mlfq* q);
+
+/**
+ * \brief Frees all tasks of the scheduler. `q` itself is not freed.
+ *
+ * \param q The scheduler
+ */
+void stud_MLFQ_destroy(struct mlfq* q);
+
+/**
+ * \brief Returns the running task, `NULL` if the CPU is idle
+ *
+ * \param q The scheduler
+ */
+struct task* stud_MLFQ_running(struct mlfq* q);
+
+void stud_MLFQ_start(struct mlfq* q, int pid);
+void stud_MLFQ_terminate(struct mlfq* q);
+void stud_MLFQ_clock_tick(struct mlfq* q);
+void stud_MLFQ_wait(struct mlfq* q);
+void stud_MLFQ_wake_up(struct mlfq* q, int pid);
+
+/**
+ * \brief Event handler for MLFQ
+ *
+ * \param q     The scheduler
+ * \param event The event to be handled
+ * \param pid   Depending on `event`, the `pid` of the target process.
+ *              If the `event` doesn't need this, it is ignored.
+ */
+void stud_MLFQ(struct mlfq* q, enum events event, int pid);
+
+#endif // SCHEDULER_MLFQ_H__
@@ -2,6 +2,7 @@
 #include "scheduler.h"
 #include "scheduler_round_robin.h"
 #include "doubly_linked_list.h"
+#include "../metrics/metrics.h"
 
 /**
  * \brief Enqueues a process in READY state
@@ -39,6 +40,8 @@ void stud_RR_elect(struct run_queue* rq) {
     }
     cur->state = RUNNING;
     rq->time_counter = 0;
+    METRIC_INC(CNT_CONTEXT_SWITCHES);
+    METRIC_RECORD(HIST_RUNQ_DEPTH, rq->n_tasks);
 }
 
 /**
@@ -72,6 +75,7 @@ void stud_RR_clock_tick(struct run_queue* rq) {
         return;
     rq->time_counter++;
     if (rq->time_counter >= QUANTUM) {
+        METRIC_INC(CNT_PREEMPTIONS);
         struct task *t = rq->head;
         t->state = READY;
         rq->head = t->next;
@@ -0,0 +1,112 @@
+// scheduler_rr_adaptive.c
+#include "scheduler.h"
+#include "scheduler_rr_adaptive.h"
+#include "scheduler_round_robin.h"
+#include "doubly_linked_list.h"
+#include "../metrics/metrics.h"
+
+/**
+ * \brief Picks the smallest quantum that covers ARR_PERCENTILE percent of the
+ *        bursts in the histogram, then halves the histogram so that old
+ *        bursts fade out.
+ */
+static void arr_update_quantum(struct rr_adaptive* arr) {
+    unsigned int want = (arr->n_bursts * ARR_PERCENTILE + 99) / 100;
+    unsigned int seen = 0;
+    int q = ARR_MAX_QUANTUM;
+    for (int len = 0; len <= ARR_MAX_QUANTUM; ++len) {
+        seen += arr->hist[len];
+        if (seen >= want) {
+            q = len;
+            break;
+        }
+    }
+    if (q < ARR_MIN_QUANTUM)
+        q = ARR_MIN_QUANTUM;
+    arr->quantum = q;
+
+    arr->n_bursts = 0;
+    for (int len = 0; len <= ARR_MAX_QUANTUM; ++len) {
+        arr->hist[len] /= 2;
+        arr->n_bursts += arr->hist[len];
+    }
+    arr->since_update = 0;
+}
+
+/**
+ * \brief Records the finished burst of the running process
+ */
+static void arr_end_burst(struct rr_adaptive* arr) {
+    struct task* t = arr->rq.head;
+    if (!t || t->state != RUNNING)
+        return;
+    int len = t->burst < ARR_MAX_QUANTUM ? t->burst : ARR_MAX_QUANTUM;
+    arr->hist[len]++;
+    arr->n_bursts++;
+    t->burst = 0;
+    if (++arr->since_update >= ARR_WINDOW)
+        arr_update_quantum(arr);
+}
+
+void stud_ARR_init(struct rr_adaptive* arr) {
+    arr->rq = (struct run_queue){ .head = NULL };
+    arr->quantum = QUANTUM;
+    for (int len = 0; len <= ARR_MAX_QUANTUM; ++len)
+        arr->hist[len] = 0;
+    arr->n_bursts = 0;
+    arr->since_update = 0;
+}
+
+/**
+ * \brief Performs a clock tick with the current adaptive quantum. An idle CPU
+ *        elects a new process right away.
+ *
+ * \param arr The scheduler
+ */
+void stud_ARR_clock_tick(struct rr_adaptive* arr) {
+    struct run_queue* rq = &arr->rq;
+    struct task* t = rq->head;
+    if (!t)
+        return;
+    if (t->state != RUNNING) {
+        stud_RR_elect(rq);
+        return;
+    }
+    t->burst++;
+    if (++rq->time_counter >= arr->quantum) {
+        METRIC_INC(CNT_PREEMPTIONS);
+        t->state = READY;
+        rq->head = t->next;
+        if (rq->head)
+            rq->head->prev = NULL;
+        t->prev = t->next = NULL;
+        rq->n_tasks--;
+        stud_rq_enqueue(rq, t);
+        stud_RR_elect(rq);
+    }
+}
+
+void stud_ARR(struct rr_adaptive* arr, enum events event, int pid) {
+    switch(event) {
+        case start:
+            stud_RR_start(&arr->rq, pid);
+            break;
+        case terminate:
+            arr_end_burst(arr);
+            stud_RR_terminate(&arr->rq);
+            break;
+        case clock_tick:
+            stud_ARR_clock_tick(arr);
+            break;
+        case wait:
+            arr_end_burst(arr);
+            stud_RR_wait(&arr->rq);
+            break;
+        case wake_up:
+            stud_RR_wake_up(&arr->rq, pid);
+            break;
+        default:
+            /* ignored */
+            break;
+    }
+}
@@ -0,0 +1,46 @@
+#ifndef SCHEDULER_RR_ADAPTIVE_H__
+#define SCHEDULER_RR_ADAPTIVE_H__
+
+#include "scheduler.h"
+
+// Bounds of the adaptive quantum
+#define ARR_MIN_QUANTUM 2
+#define ARR_MAX_QUANTUM (8 * QUANTUM)
+
+// Share of the observed bursts (in percent) that should fit into one quantum
+#define ARR_PERCENTILE 80
+
+// The quantum is recomputed after every ARR_WINDOW finished bursts
+#define ARR_WINDOW 32
+
+// RR whose quantum follows the observed burst distribution
+struct rr_adaptive {
+    struct run_queue rq;
+    int quantum;
+    unsigned int hist[ARR_MAX_QUANTUM + 1]; // finished bursts by length
+    unsigned int n_bursts;                  // bursts in `hist`
+    unsigned int since_update;
+};
+
+/**
+ * \brief Initializes an empty scheduler with the quantum set to QUANTUM
+ *
+ * \param arr The scheduler to be initialized
+ */
+void stud_ARR_init(struct rr_adaptive* arr);
+
+void stud_ARR_clock_tick(struct rr_adaptive* arr);
+
+/**
+ * \brief Event handler for adaptive RR. Behaves like RR, except that the
+ *        quantum is chosen so that ARR_PERCENTILE percent of the recently
+ *        observed CPU bursts complete within a single quantum.
+ *
+ * \param arr   The scheduler
+ * \param event The event to be handled
+ * \param pid   Depending on `event`, the `pid` of the target process.
+ *              If the `event` doesn't need this, it is ignored.
+ */
+void stud_ARR(struct rr_adaptive* arr, enum events event, int pid);
+
+#endif // SCHEDULER_RR_ADAPTIVE_H__
@@ -2,6 +2,7 @@
 #include "scheduler.h"
 #include "scheduler_sjf.h"
 #include "doubly_linked_list.h"
+#include "../metrics/metrics.h"
 
 /**
  * \brief Enqueues a process in READY state
@@ -41,6 +42,8 @@ void stud_SJF_elect(struct run_queue* rq){
     }
     cur->state = RUNNING;
     rq->time_counter = 0;
+    METRIC_INC(CNT_CONTEXT_SWITCHES);
+    METRIC_RECORD(HIST_RUNQ_DEPTH, rq->n_tasks);
 }
 
 /**
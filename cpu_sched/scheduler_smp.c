@@ -0,0 +1,329 @@
+// scheduler_smp.c
+#include "scheduler.h"
+#include "scheduler_smp.h"
+#include "scheduler_round_robin.h"
+#include "doubly_linked_list.h"
+#include "../metrics/metrics.h"
+
+/**
+ * \brief Removes `t` from `rq` without freeing it
+ */
+static void rq_unlink(struct run_queue* rq, struct task* t) {
+    if (t->prev) t->prev->next = t->next;
+    else         rq->head = t->next;
+    if (t->next) t->next->prev = t->prev;
+    t->prev = t->next = NULL;
+    rq->n_tasks--;
+}
+
+static bool cpu_is_running(struct cpu* c) {
+    return c->rq.head && c->rq.head->state == RUNNING;
+}
+
+/**
+ * \brief Frees all TERMINATED tasks of the CPU. Must hold `c->lock`.
+ */
+static void cpu_reap(struct cpu* c) {
+    struct task* t = c->rq.head;
+    while (t) {
+        struct task* next = t->next;
+        if (t->state == TERMINATED) {
+            rq_unlink(&c->rq, t);
+            stud_task_free(t);
+        }
+        t = next;
+    }
+}
+
+/**
+ * \brief Elects a task if the CPU is idle and refreshes the load counters.
+ *        Must hold `c->lock`.
+ *
+ * \returns `true` iff the CPU is still idle
+ */
+static bool cpu_settle(struct cpu* c) {
+    if (!cpu_is_running(c))
+        stud_RR_elect(&c->rq);
+    int ready = 0;
+    for (struct task* t = c->rq.head; t; t = t->next)
+        if (t->state == READY)
+            ready++;
+    bool running = cpu_is_running(c);
+    atomic_store(&c->nr_ready, ready);
+    atomic_store(&c->load, ready + running);
+    return !running;
+}
+
+/**
+ * \brief Moves half of the READY tasks of the busiest peer to the idle CPU `c`,
+ *        honouring the affinity masks of the tasks.
+ */
+static void cpu_steal(struct cpu* c) {
+    struct smp_sched* s = c->sched;
+    struct cpu* victim = NULL;
+    int best = 0;
+    for (int i = 0; i < s->n_cpus; ++i) {
+        int n = atomic_load(&s->cpus[i].nr_ready);
+        if (i != c->id && n > best) {
+            best = n;
+            victim = &s->cpus[i];
+        }
+    }
+    if (!victim)
+        return;
+    atomic_fetch_add(&c->steal_attempts, 1);
+
+    struct cpu* first  = c->id < victim->id ? c : victim;
+    struct cpu* second = c->id < victim->id ? victim : c;
+    pthread_mutex_lock(&first->lock);
+    pthread_mutex_lock(&second->lock);
+
+    int want = (atomic_load(&victim->nr_ready) + 1) / 2;
+    int moved = 0;
+    struct task* t = victim->rq.head;
+    while (t && moved < want) {
+        struct task* next = t->next;
+        if (t->state == READY && (t->affinity >> c->id & 1)) {
+            rq_unlink(&victim->rq, t);
+            stud_rq_enqueue(&c->rq, t);
+            moved++;
+        }
+        t = next;
+    }
+    cpu_settle(victim);
+    cpu_settle(c);
+
+    pthread_mutex_unlock(&second->lock);
+    pthread_mutex_unlock(&first->lock);
+
+    if (moved) {
+        atomic_fetch_add(&c->steals, 1);
+        atomic_fetch_add(&c->migrations, (unsigned long)moved);
+        METRIC_ADD(CNT_MIGRATIONS, moved);
+    }
+}
+
+/**
+ * \brief Runs one event on the CPU's run queue with RR semantics. Events that
+ *        act on the running task are ignored while the CPU is idle.
+ */
+static void cpu_handle(struct cpu* c, struct smp_event* ev) {
+    pthread_mutex_lock(&c->lock);
+    switch (ev->event) {
+        case start: {
+            stud_RR_start(&c->rq, ev->pid);
+            struct task* t = stud_rq_find(&c->rq, ev->pid);
+            if (t && ev->affinity)
+                t->affinity = ev->affinity;
+            break;
+        }
+        case wake_up:
+            stud_RR_wake_up(&c->rq, ev->pid);
+            break;
+        case terminate:
+            if (cpu_is_running(c)) {
+                stud_RR_terminate(&c->rq);
+                cpu_reap(c);
+            }
+            break;
+        case wait:
+        case clock_tick:
+            if (cpu_is_running(c))
+                stud_RR(&c->rq, ev->event, ev->pid);
+            break;
+        default:
+            break;
+    }
+    bool idle = cpu_settle(c);
+    pthread_mutex_unlock(&c->lock);
+    if (idle)
+        cpu_steal(c);
+}
+
+static void* cpu_main(void* arg) {
+    struct cpu* c = arg;
+    for (;;) {
+        pthread_mutex_lock(&c->mbox_lock);
+        while (!c->mbox_count && !c->stop)
+            pthread_cond_wait(&c->mbox_not_empty, &c->mbox_lock);
+        if (!c->mbox_count) {
+            pthread_mutex_unlock(&c->mbox_lock);
+            break;
+        }
+        struct smp_event ev = c->mbox[c->mbox_head];
+        c->mbox_head = (c->mbox_head + 1) % SMP_MAILBOX;
+        c->mbox_count--;
+        pthread_cond_signal(&c->mbox_not_full);
+        pthread_mutex_unlock(&c->mbox_lock);
+
+        cpu_handle(c, &ev);
+    }
+    return NULL;
+}
+
+static void cpu_post(struct cpu* c, struct smp_event ev) {
+    pthread_mutex_lock(&c->mbox_lock);
+    while (c->mbox_count == SMP_MAILBOX)
+        pthread_cond_wait(&c->mbox_not_full, &c->mbox_lock);
+    c->mbox[(c->mbox_head + c->mbox_count) % SMP_MAILBOX] = ev;
+    c->mbox_count++;
+    pthread_cond_signal(&c->mbox_not_empty);
+    pthread_mutex_unlock(&c->mbox_lock);
+}
+
+int smp_init(struct smp_sched* s, int n_cpus) {
+    if (n_cpus < 1 || n_cpus > SMP_MAX_CPUS)
+        return -1;
+    s->cpus = calloc((size_t)n_cpus, sizeof(*s->cpus));
+    if (!s->cpus)
+        return -1;
+    s->n_cpus = n_cpus;
+    s->ticks = 0;
+    s->imbalance_sum = 0;
+    s->imbalance_max = 0;
+    pthread_mutex_init(&s->sample_lock, NULL);
+
+    for (int i = 0; i < n_cpus; ++i) {
+        struct cpu* c = &s->cpus[i];
+        c->id = i;
+        c->sched = s;
+        pthread_mutex_init(&c->lock, NULL);
+        pthread_mutex_init(&c->mbox_lock, NULL);
+        pthread_cond_init(&c->mbox_not_empty, NULL);
+        pthread_cond_init(&c->mbox_not_full, NULL);
+        atomic_init(&c->nr_ready, 0);
+        atomic_init(&c->load, 0);
+        atomic_init(&c->migrations, 0);
+        atomic_init(&c->steal_attempts, 0);
+        atomic_init(&c->steals, 0);
+    }
+    for (int i = 0; i < n_cpus; ++i) {
+        if (pthread_create(&s->cpus[i].thread, NULL, cpu_main, &s->cpus[i])) {
+            s->n_cpus = i;
+            smp_shutdown(s, NULL);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+void smp_shutdown(struct smp_sched* s, FILE* report) {
+    for (int i = 0; i < s->n_cpus; ++i) {
+        struct cpu* c = &s->cpus[i];
+        pthread_mutex_lock(&c->mbox_lock);
+        c->stop = true;
+        pthread_cond_signal(&c->mbox_not_empty);
+        pthread_mutex_unlock(&c->mbox_lock);
+    }
+    for (int i = 0; i < s->n_cpus; ++i)
+        pthread_join(s->cpus[i].thread, NULL);
+    if (report)
+        smp_report(s, report);
+    for (int i = 0; i < s->n_cpus; ++i) {
+        struct cpu* c = &s->cpus[i];
+        stud_rq_destroy(&c->rq);
+        pthread_mutex_destroy(&c->lock);
+        pthread_mutex_destroy(&c->mbox_lock);
+        pthread_cond_destroy(&c->mbox_not_empty);
+        pthread_cond_destroy(&c->mbox_not_full);
+    }
+    pthread_mutex_destroy(&s->sample_lock);
+    free(s->cpus);
+    s->cpus = NULL;
+    s->n_cpus = 0;
+}
+
+void smp_start(struct smp_sched* s, int pid, uint64_t affinity) {
+    struct cpu* target = NULL;
+    int best = 0;
+    for (int i = 0; i < s->n_cpus; ++i) {
+        if (affinity && !(affinity >> i & 1))
+            continue;
+        int load = atomic_load(&s->cpus[i].load);
+        if (!target || load < best) {
+            target = &s->cpus[i];
+            best = load;
+        }
+    }
+    if (!target)
+        return;
+    // count the task right away so back-to-back starts spread out
+    atomic_fetch_add(&target->load, 1);
+    cpu_post(target, (struct smp_event){ start, pid, affinity });
+}
+
+void smp_post(struct smp_sched* s, int cpu, enum events event, int pid) {
+    if (event == start) {
+        smp_start(s, pid, 0);
+        return;
+    }
+    if (cpu < 0 && event == wake_up) {
+        // blocked tasks are never stolen, so their owner is stable
+        for (int i = 0; i < s->n_cpus && cpu < 0; ++i) {
+            struct cpu* c = &s->cpus[i];
+            pthread_mutex_lock(&c->lock);
+            if (stud_rq_find(&c->rq, pid))
+                cpu = i;
+            pthread_mutex_unlock(&c->lock);
+        }
+    }
+    if (cpu < 0 || cpu >= s->n_cpus)
+        return;
+    cpu_post(&s->cpus[cpu], (struct smp_event){ event, pid, 0 });
+}
+
+void smp_tick(struct smp_sched* s) {
+    int lo = 0, hi = 0;
+    for (int i = 0; i < s->n_cpus; ++i) {
+        int load = atomic_load(&s->cpus[i].load);
+        if (i == 0 || load < lo) lo = load;
+        if (i == 0 || load > hi) hi = load;
+    }
+    pthread_mutex_lock(&s->sample_lock);
+    s->imbalance[s->ticks % SMP_SAMPLES] = hi - lo;
+    s->imbalance_sum += (unsigned long)(hi - lo);
+    if (hi - lo > s->imbalance_max)
+        s->imbalance_max = hi - lo;
+    s->ticks++;
+    pthread_mutex_unlock(&s->sample_lock);
+
+    for (int i = 0; i < s->n_cpus; ++i)
+        cpu_post(&s->cpus[i], (struct smp_event){ clock_tick, 0, 0 });
+}
+
+void smp_report(struct smp_sched* s, FILE* out) {
+    unsigned long migrations = 0, attempts = 0, steals = 0;
+    fprintf(out, "cpu  load  migrations  steal_attempts  steals\n");
+    for (int i = 0; i < s->n_cpus; ++i) {
+        struct cpu* c = &s->cpus[i];
+        unsigned long m = atomic_load(&c->migrations);
+        unsigned long a = atomic_load(&c->steal_attempts);
+        unsigned long st = atomic_load(&c->steals);
+        fprintf(out, "%3d  %4d  %10lu  %14lu  %6lu\n", i, atomic_load(&c->load), m, a, st);
+        migrations += m;
+        attempts += a;
+        steals += st;
+    }
+    fprintf(out, "total migrations %lu, steal attempts %lu, successful steals %lu\n",
+            migrations, attempts, steals);
+
+    pthread_mutex_lock(&s->sample_lock);
+    if (s->ticks) {
+        fprintf(out, "load imbalance over %lu ticks: avg %.2f, max %d\n", s->ticks,
+                (double)s->imbalance_sum / (double)s->ticks, s->imbalance_max);
+        // the last SMP_SAMPLES ticks, averaged into 16 windows
+        unsigned long n = s->ticks < SMP_SAMPLES ? s->ticks : SMP_SAMPLES;
+        unsigned long first = s->ticks - n;
+        unsigned long windows = n < 16 ? n : 16;
+        fprintf(out, "imbalance by window:");
+        for (unsigned long w = 0; w < windows; ++w) {
+            unsigned long lo = first + w * n / windows, hi = first + (w + 1) * n / windows;
+            unsigned long sum = 0;
+            for (unsigned long t = lo; t < hi; ++t)
+                sum += (unsigned long)s->imbalance[t % SMP_SAMPLES];
+            fprintf(out, " %.2f", (double)sum / (double)(hi - lo));
+        }
+        fprintf(out, "\n");
+    }
+    pthread_mutex_unlock(&s->sample_lock);
+}
@@ -0,0 +1,114 @@
+#ifndef SCHEDULER_SMP_H__
+#define SCHEDULER_SMP_H__
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include "scheduler.h"
+
+#define SMP_MAX_CPUS 64
+
+// Capacity of the event mailbox of each CPU
+#define SMP_MAILBOX 256
+
+// Number of load imbalance samples kept for the report
+#define SMP_SAMPLES 1024
+
+struct smp_event {
+    enum events event;
+    int pid;
+    uint64_t affinity; // only used by `start`
+};
+
+struct smp_sched;
+
+// One simulated core: its own RR run queue plus the thread handling its events
+struct cpu {
+    int id;
+    struct smp_sched* sched;
+    pthread_t thread;
+
+    pthread_mutex_t lock; // protects rq
+    struct run_queue rq;
+    atomic_int nr_ready;  // READY tasks in rq, readable without the lock
+    atomic_int load;      // READY + RUNNING tasks in rq
+
+    pthread_mutex_t mbox_lock;
+    pthread_cond_t mbox_not_empty;
+    pthread_cond_t mbox_not_full;
+    struct smp_event mbox[SMP_MAILBOX];
+    size_t mbox_head;
+    size_t mbox_count;
+    bool stop;
+
+    atomic_ulong migrations;     // tasks stolen by this CPU
+    atomic_ulong steal_attempts;
+    atomic_ulong steals;         // attempts that moved at least one task
+};
+
+struct smp_sched {
+    int n_cpus;
+    struct cpu* cpus;
+
+    pthread_mutex_t sample_lock;
+    unsigned long ticks;
+    int imbalance[SMP_SAMPLES]; // (max load - min load) per tick, ring buffer
+    unsigned long imbalance_sum;
+    int imbalance_max;
+};
+
+/**
+ * \brief Creates `n_cpus` run queues and starts one event thread per CPU
+ *
+ * \param s      The scheduler to be initialized
+ * \param n_cpus Number of simulated cores (1..SMP_MAX_CPUS)
+ *
+ * \returns 0 on success, -1 on failure
+ */
+int smp_init(struct smp_sched* s, int n_cpus);
+
+/**
+ * \brief Handles all pending events, stops the CPU threads and frees all tasks
+ *
+ * \param s      The scheduler
+ * \param report If not `NULL`, the final smp_report is printed there
+ */
+void smp_shutdown(struct smp_sched* s, FILE* report);
+
+/**
+ * \brief Starts `pid` on the least loaded CPU allowed by `affinity`
+ *
+ * \param s        The scheduler
+ * \param pid      The new process
+ * \param affinity Bit i set iff the process may run on CPU i, 0 for any CPU
+ */
+void smp_start(struct smp_sched* s, int pid, uint64_t affinity);
+
+/**
+ * \brief Posts an event to a CPU. `wait`, `terminate` and `clock_tick` act on
+ *        the task running on `cpu`. For `wake_up` a negative `cpu` routes the
+ *        event to the CPU owning `pid`.
+ *
+ * \param s     The scheduler
+ * \param cpu   Target CPU
+ * \param event The event to be handled
+ * \param pid   Target process if `event` needs one
+ */
+void smp_post(struct smp_sched* s, int cpu, enum events event, int pid);
+
+/**
+ * \brief Sends a clock tick to every CPU and samples the load imbalance
+ *
+ * \param s The scheduler
+ */
+void smp_tick(struct smp_sched* s);
+
+/**
+ * \brief Prints migrations, steal attempts and load imbalance over time.
+ *        May be called while the CPUs are running.
+ *
+ * \param s   The scheduler
+ * \param out Output stream
+ */
+void smp_report(struct smp_sched* s, FILE* out);
+
+#endif // SCHEDULER_SMP_H__
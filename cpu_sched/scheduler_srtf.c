@@ -0,0 +1,176 @@
+// scheduler_srtf.c
+#include "scheduler.h"
+#include "scheduler_srtf.h"
+#include "doubly_linked_list.h"
+#include "../metrics/metrics.h"
+
+/**
+ * \brief Predicted remaining time of the current burst of `t`
+ */
+static int srtf_remaining(struct task const* t) {
+    int rem = t->predicted - t->burst;
+    return rem > 0 ? rem : 0;
+}
+
+/**
+ * \brief Removes `t` from `rq` and appends it at the BACK
+ */
+static void srtf_requeue(struct run_queue* rq, struct task* t) {
+    if (t->prev) t->prev->next = t->next;
+    else         rq->head = t->next;
+    if (t->next) t->next->prev = t->prev;
+    rq->n_tasks--;
+    t->prev = t->next = NULL;
+    stud_rq_enqueue(rq, t);
+}
+
+/**
+ * \brief Returns the READY task with the shortest predicted remaining time,
+ *        `NULL` if there is none. Ties go to the task closer to the head.
+ */
+static struct task* srtf_shortest(struct run_queue* rq) {
+    struct task* best = NULL;
+    for (struct task* cur = rq->head; cur; cur = cur->next)
+        if (cur->state == READY && (!best || srtf_remaining(cur) < srtf_remaining(best)))
+            best = cur;
+    return best;
+}
+
+/**
+ * \brief Elects a new process if the CPU is idle, or preempts the running
+ *        process if a READY one is predicted to finish its burst earlier.
+ */
+static void srtf_check_preempt(struct run_queue* rq) {
+    struct task* head = rq->head;
+    if (!head || head->state != RUNNING) {
+        stud_SRTF_elect(rq);
+        return;
+    }
+    struct task* best = srtf_shortest(rq);
+    if (best && srtf_remaining(best) < srtf_remaining(head)) {
+        METRIC_INC(CNT_PREEMPTIONS);
+        head->state = READY;
+        stud_SRTF_elect(rq);
+    }
+}
+
+/**
+ * \brief Ends the current burst of `t` and updates its prediction
+ */
+static void srtf_end_burst(struct task* t) {
+    t->predicted = (SRTF_ALPHA * t->burst + (8 - SRTF_ALPHA) * t->predicted) / 8;
+    t->burst = 0;
+}
+
+/**
+ * \brief Enqueues a process in READY state, preempting the running process if
+ *        the new one is predicted to be shorter.
+ *
+ * \param rq  The scheduler's run queue
+ * \param pid The process to be enqueued
+ */
+void stud_SRTF_start(struct run_queue* rq, int pid) {
+    if (stud_rq_find(rq, pid))
+        return;
+    struct task* t = stud_task_create(pid, READY);
+    if (!t) return;
+    stud_rq_enqueue(rq, t);
+    srtf_check_preempt(rq);
+}
+
+/**
+ * \brief Elects the READY process with the shortest predicted remaining time
+ *        and places it at the head of `rq`.
+ *
+ * \param rq  The scheduler's run queue
+ */
+void stud_SRTF_elect(struct run_queue* rq) {
+    struct task* cur = srtf_shortest(rq);
+    if (!cur)
+        return;
+    if (cur != rq->head) {
+        if (cur->prev) cur->prev->next = cur->next;
+        if (cur->next) cur->next->prev = cur->prev;
+        cur->next = rq->head;
+        rq->head->prev = cur;
+        cur->prev = NULL;
+        rq->head = cur;
+    }
+    cur->state = RUNNING;
+    rq->time_counter = 0;
+    METRIC_INC(CNT_CONTEXT_SWITCHES);
+    METRIC_RECORD(HIST_RUNQ_DEPTH, rq->n_tasks);
+}
+
+/**
+ * \brief Terminates the running process and places it at the BACK of the
+ *        run_queue.
+ *
+ * \param rq  The scheduler's run queue
+ */
+void stud_SRTF_terminate(struct run_queue* rq) {
+    struct task* t = rq->head;
+    if (!t || t->state != RUNNING)
+        return;
+    t->state = TERMINATED;
+    t->runtime = 0;
+    t->burst = 0;
+    srtf_requeue(rq, t);
+    stud_SRTF_elect(rq);
+}
+
+/**
+ * \brief Accounts one tick to the running process.
+ *
+ * \param rq  The scheduler's run queue
+ */
+void stud_SRTF_clock_tick(struct run_queue* rq) {
+    struct task* t = rq->head;
+    if (t && t->state == RUNNING) {
+        t->runtime++;
+        t->burst++;
+    }
+}
+
+/**
+ * \brief Blocks the running process, updates its burst prediction, moves it to
+ *        the BACK of the run_queue and elects a new process.
+ *
+ * \param rq  The scheduler's run queue
+ */
+void stud_SRTF_wait(struct run_queue* rq) {
+    struct task* t = rq->head;
+    if (!t || t->state != RUNNING)
+        return;
+    t->state = BLOCKED;
+    srtf_end_burst(t);
+    srtf_requeue(rq, t);
+    stud_SRTF_elect(rq);
+}
+
+/**
+ * \brief Sets the state of `pid` to READY, if it is blocked, and preempts the
+ *        running process if `pid` is predicted to be shorter.
+ *
+ * \param rq  The scheduler's run queue
+ * \param pid The process to be woken up
+ */
+void stud_SRTF_wake_up(struct run_queue* rq, int pid) {
+    struct task* t = stud_rq_find(rq, pid);
+    if (t && t->state == BLOCKED) {
+        t->state = READY;
+        srtf_requeue(rq, t);
+        srtf_check_preempt(rq);
+    }
+}
+
+void stud_SRTF(struct run_queue* rq, enum events event, int pid) {
+    switch(event) {
+        case start:      stud_SRTF_start(rq, pid);     break;
+        case terminate:  stud_SRTF_terminate(rq);      break;
+        case clock_tick: stud_SRTF_clock_tick(rq);     break;
+        case wait:       stud_SRTF_wait(rq);           break;
+        case wake_up:    stud_SRTF_wake_up(rq, pid);   break;
+        default:         /* ignored */                 break;
+    }
+}
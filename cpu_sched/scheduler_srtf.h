@@ -0,0 +1,28 @@
+#ifndef SCHEDULER_SRTF_H__
+#define SCHEDULER_SRTF_H__
+
+#include "scheduler.h"
+
+// Weight of the last burst in the exponential average, in eighths
+#define SRTF_ALPHA 4
+
+void stud_SRTF_start(struct run_queue* rq, int pid);
+void stud_SRTF_elect(struct run_queue* rq);
+void stud_SRTF_terminate(struct run_queue* rq);
+void stud_SRTF_clock_tick(struct run_queue* rq);
+void stud_SRTF_wait(struct run_queue* rq);
+void stud_SRTF_wake_up(struct run_queue* rq, int pid);
+
+/**
+ * \brief Event handler for preemptive shortest-remaining-time-first. The next
+ *        burst of a task is predicted by exponential averaging of its past
+ *        bursts: tau' = alpha * burst + (1 - alpha) * tau.
+ *
+ * \param rq    The scheduler's run queue
+ * \param event The event to be handled
+ * \param pid   Depending on `event`, the `pid` of the target process.
+ *              If the `event` doesn't need this, it is ignored.
+ */
+void stud_SRTF(struct run_queue* rq, enum events event, int pid);
+
+#endif // SCHEDULER_SRTF_H__
@@ -0,0 +1,505 @@
+/*
+  Benchmark of the disk scheduling policies on the simulated drive of
+  disk_sim.c. Build with -DDISK_SIM together with disk_scheduling.c,
+  disk_online.c, disk_multiq.c and disk_sim.c (link with -lm -lpthread).
+
+  usage: disk_bench [-n requests] [-i mean interarrival us] [-q queue depth]
+                    [-c cylinders] [-r rpm] [-t trace] [-m]
+
+  Requests arrive over time. Whenever the drive becomes idle, every request
+  that has arrived so far (at most queue depth) is handed to the policy as one
+  batch. A trace has one request per line: `<arrival_us> <cylinder>`, sorted
+  by arrival time.
+
+  With -m, the requests are striped over arrays of 1, 2, 4 and 8 drives
+  instead, and the dispatcher of disk_multiq.c serves them with a worker
+  thread per drive.
+
+  Built with -DMETRICS and ../metrics/metrics.c (link with -lpthread), the
+  counters of all runs are summed up at the end, and `kill -USR1` dumps them
+  to stderr while the benchmark is running.
+*/
+#include <math.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "disk_sim.h"
+#include "disk_scheduling.h"
+#include "disk_online.h"
+#include "disk_multiq.h"
+#include "../metrics/metrics.h"
+#ifdef METRICS
+#include <signal.h>
+#endif
+
+struct workload {
+    const char* name;
+    size_t n;
+    int* cyl;
+    double* arrival;
+};
+
+struct policy {
+    const char* name;
+    int (*run)(struct device_t* device, int requests[], int size);
+};
+
+// LOOK_deadline on a batch: every request may wait one full stroke, the
+// older ones a little less, before it is served ahead of the sweep
+static int LOOK_deadline_batch(struct device_t* device, int requests[], int size){
+    if(size <= 0) return 0;
+    long long* deadlines = malloc((size_t)size * sizeof(*deadlines));
+    if(!deadlines) return -1;
+    long long slack = dev_get_max_cylinder(device);
+    for(int i = 0; i < size; ++i)
+        deadlines[i] = slack + i;
+    int dist = LOOK_deadline(device, requests, deadlines, size, NULL);
+    free(deadlines);
+    return dist;
+}
+
+// The online elevator of disk_online.c, fed one batch at a time
+static int online_batch(struct device_t* device, int requests[], int size){
+    struct disk_online s;
+    if(disk_online_init(&s, device)) return -1;
+    int ret = 0;
+    for(int i = 0; i < size && ret == 0; ++i)
+        ret = disk_online_submit(&s, requests[i], 0);
+    while(ret == 0 && disk_online_pending(&s))
+        if(disk_online_next(&s) == -1) ret = -1;
+    if(ret == 0) ret = (int)s.total_seek;
+    disk_online_destroy(&s);
+    return ret;
+}
+
+static const struct policy policies[] = {
+    { "FCFS",    FCFS                },
+    { "SSF",     SSF                 },
+    { "SCAN",    SCAN                },
+    { "LOOK",    LOOK                },
+    { "C-SCAN",  C_SCAN              },
+    { "C-LOOK",  C_LOOK              },
+    { "LOOK-DL", LOOK_deadline_batch },
+    { "online",  online_batch        },
+};
+
+// ----- workloads ----- //
+
+static unsigned long long rng_state = 88172645463325252ULL;
+
+static unsigned long long rng(void){
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+// uniform in [0, 1)
+static double rng_unit(void){
+    return (double)(rng() >> 11) / 9007199254740992.0;
+}
+
+static double rng_exp(double mean){
+    return -mean * log(1.0 - rng_unit());
+}
+
+static int workload_alloc(struct workload* w, const char* name, size_t n){
+    w->name = name;
+    w->n = n;
+    w->cyl = malloc(n * sizeof(*w->cyl));
+    w->arrival = malloc(n * sizeof(*w->arrival));
+    if(w->cyl && w->arrival) return 0;
+    free(w->cyl);
+    free(w->arrival);
+    return -1;
+}
+
+static void workload_free(struct workload* w){
+    free(w->cyl);
+    free(w->arrival);
+}
+
+static void poisson_arrivals(struct workload* w, double mean){
+    double t = 0;
+    for(size_t i = 0; i < w->n; ++i){
+        t += rng_exp(mean);
+        w->arrival[i] = t;
+    }
+}
+
+static int gen_uniform(struct workload* w, size_t n, int cylinders, double mean){
+    if(workload_alloc(w, "uniform", n)) return -1;
+    for(size_t i = 0; i < n; ++i)
+        w->cyl[i] = (int)(rng() % (unsigned)cylinders);
+    poisson_arrivals(w, mean);
+    return 0;
+}
+
+// Zipf(1) over cylinders; hot cylinders are scattered over the disk
+static int gen_zipf(struct workload* w, size_t n, int cylinders, double mean){
+    if(workload_alloc(w, "zipf", n)) return -1;
+    double* cdf = malloc((size_t)cylinders * sizeof(*cdf));
+    if(!cdf){
+        workload_free(w);
+        return -1;
+    }
+    double sum = 0;
+    for(int r = 0; r < cylinders; ++r){
+        sum += 1.0 / (r + 1);
+        cdf[r] = sum;
+    }
+    for(size_t i = 0; i < n; ++i){
+        double u = rng_unit() * sum;
+        int lo = 0, hi = cylinders - 1;
+        while(lo < hi){
+            int mid = (lo + hi) / 2;
+            if(cdf[mid] < u) lo = mid + 1;
+            else hi = mid;
+        }
+        w->cyl[i] = (int)((long long)lo * 7919 % cylinders);
+    }
+    free(cdf);
+    poisson_arrivals(w, mean);
+    return 0;
+}
+
+// A few interleaved streams, each reading consecutive sectors and moving on
+// to the next cylinder now and then
+static int gen_sequential(struct workload* w, size_t n, int cylinders, double mean){
+    enum { STREAMS = 4 };
+    if(workload_alloc(w, "sequential", n)) return -1;
+    int pos[STREAMS];
+    for(int s = 0; s < STREAMS; ++s)
+        pos[s] = (int)(rng() % (unsigned)cylinders);
+    for(size_t i = 0; i < n; ++i){
+        int s = (int)(rng() % STREAMS);
+        if(rng() % 16 == 0)
+            pos[s] = (pos[s] + 1) % cylinders;
+        w->cyl[i] = pos[s];
+    }
+    poisson_arrivals(w, mean);
+    return 0;
+}
+
+// Uniform cylinders, but requests arrive in bursts of up to 64 at once; the
+// mean arrival rate is the same as for the other workloads
+static int gen_bursty(struct workload* w, size_t n, int cylinders, double mean){
+    if(workload_alloc(w, "bursty", n)) return -1;
+    double t = 0;
+    size_t i = 0;
+    while(i < n){
+        size_t burst = 1 + rng() % 64;
+        t += rng_exp(mean * (double)burst);
+        for(size_t k = 0; k < burst && i < n; ++k, ++i){
+            w->cyl[i] = (int)(rng() % (unsigned)cylinders);
+            w->arrival[i] = t;
+        }
+    }
+    return 0;
+}
+
+static int load_trace(struct workload* w, const char* path, int cylinders){
+    FILE* in = fopen(path, "r");
+    if(!in) return -1;
+    size_t cap = 1024;
+    if(workload_alloc(w, "trace", cap)){
+        fclose(in);
+        return -1;
+    }
+    w->n = 0;
+    double t;
+    int c;
+    while(fscanf(in, "%lf %d", &t, &c) == 2){
+        if(w->n == cap){
+            cap *= 2;
+            int* cyl = realloc(w->cyl, cap * sizeof(*cyl));
+            if(cyl) w->cyl = cyl;
+            double* arrival = realloc(w->arrival, cap * sizeof(*arrival));
+            if(arrival) w->arrival = arrival;
+            if(!cyl || !arrival) break;
+        }
+        w->cyl[w->n] = c < 0 ? 0 : c >= cylinders ? cylinders - 1 : c;
+        w->arrival[w->n] = t;
+        w->n++;
+    }
+    fclose(in);
+    return 0;
+}
+
+// ----- simulation ----- //
+
+struct result {
+    double duration_us;
+    double seek_us, rotation_us, transfer_us;
+    long long distance;
+    double* latency;
+};
+
+static int cmp_u64(const void* a, const void* b){
+    unsigned long long x = *(const unsigned long long*)a;
+    unsigned long long y = *(const unsigned long long*)b;
+    return (x > y) - (x < y);
+}
+
+static int cmp_double(const void* a, const void* b){
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+/*
+  The policies only report cylinders, so the k-th request of the batch to a
+  cylinder is credited with the k-th completion at that cylinder.
+*/
+static void match_latencies(struct device_t* dev, const struct workload* w, size_t first,
+                            size_t size, unsigned long long* a, unsigned long long* b, double* latency){
+    size_t n = dev->n_served < size ? dev->n_served : size;
+    for(size_t k = 0; k < size; ++k)
+        a[k] = (unsigned long long)(unsigned)w->cyl[first + k] << 32 | k;
+    for(size_t k = 0; k < n; ++k)
+        b[k] = (unsigned long long)(unsigned)dev->served[k] << 32 | k;
+    qsort(a, size, sizeof(*a), cmp_u64);
+    qsort(b, n, sizeof(*b), cmp_u64);
+    for(size_t k = 0; k < n; ++k){
+        size_t req = first + (a[k] & 0xffffffffu);
+        latency[req] = dev->completion[b[k] & 0xffffffffu] - w->arrival[req];
+    }
+}
+
+static int simulate(const struct policy* p, const struct workload* w, const struct disk_model* m,
+                    size_t depth, struct result* r){
+    struct device_t dev;
+    if(dev_sim_init(&dev, m, m->cylinders / 2, 1)) return -1;
+    memset(r, 0, sizeof(*r));
+    r->latency = calloc(w->n, sizeof(*r->latency));
+    int* batch = malloc(depth * sizeof(*batch));
+    unsigned long long* a = malloc(depth * sizeof(*a));
+    unsigned long long* b = malloc(depth * sizeof(*b));
+    if(!r->latency || !batch || !a || !b){
+        free(r->latency); free(batch); free(a); free(b);
+        r->latency = NULL;
+        dev_sim_free(&dev);
+        return -1;
+    }
+
+    int ret = 0;
+    size_t i = 0;
+    while(i < w->n){
+        dev_sim_idle_until(&dev, w->arrival[i]);
+        size_t j = i;
+        while(j < w->n && j - i < depth && w->arrival[j] <= dev.now_us)
+            ++j;
+        for(size_t k = i; k < j; ++k)
+            batch[k - i] = w->cyl[k];
+        dev_sim_clear_log(&dev);
+        int dist = p->run(&dev, batch, (int)(j - i));
+        if(dist < 0){
+            ret = -1;
+            break;
+        }
+        r->distance += dist;
+        match_latencies(&dev, w, i, j - i, a, b, r->latency);
+        i = j;
+    }
+
+    r->duration_us = dev.now_us - (w->n ? w->arrival[0] : 0);
+    r->seek_us = dev.seek_us;
+    r->rotation_us = dev.rotation_us;
+    r->transfer_us = dev.transfer_us;
+    free(batch); free(a); free(b);
+    dev_sim_free(&dev);
+    if(ret){
+        free(r->latency);
+        r->latency = NULL;
+    }
+    return ret;
+}
+
+static double percentile(const double* sorted, size_t n, double p){
+    size_t rank = (size_t)(p / 100.0 * (double)n);
+    return sorted[rank < n ? rank : n - 1];
+}
+
+static void run_workload(const struct workload* w, const struct disk_model* m, size_t depth){
+    printf("\n%s: %zu requests\n", w->name, w->n);
+    printf("%-7s %9s %12s %9s %9s %9s %9s  %5s %5s %5s\n", "policy", "IOPS", "seek cyl",
+           "mean ms", "p50 ms", "p99 ms", "max ms", "seek%", "rot%", "xfer%");
+    for(size_t k = 0; k < sizeof(policies) / sizeof(policies[0]); ++k){
+        struct result r;
+        if(simulate(&policies[k], w, m, depth, &r)){
+            fprintf(stderr, "%s: out of memory\n", policies[k].name);
+            continue;
+        }
+        qsort(r.latency, w->n, sizeof(*r.latency), cmp_double);
+        double sum = 0;
+        for(size_t i = 0; i < w->n; ++i) sum += r.latency[i];
+        double busy = r.seek_us + r.rotation_us + r.transfer_us;
+        if(busy <= 0) busy = 1;
+        printf("%-7s %9.1f %12lld %9.2f %9.2f %9.2f %9.2f  %5.1f %5.1f %5.1f\n", policies[k].name,
+               r.duration_us > 0 ? (double)w->n / r.duration_us * 1e6 : 0.0, r.distance,
+               sum / (double)w->n / 1000, percentile(r.latency, w->n, 50) / 1000,
+               percentile(r.latency, w->n, 99) / 1000, r.latency[w->n - 1] / 1000,
+               100 * r.seek_us / busy, 100 * r.rotation_us / busy, 100 * r.transfer_us / busy);
+        free(r.latency);
+    }
+}
+
+// ----- multi-queue ----- //
+
+#define MQ_BENCH_STRIPE 64 // cylinders per stripe unit
+#define MQ_BENCH_MAX    8  // drives
+
+/*
+  Submits n uniformly random blocks of an array of `n_devices` drives at once.
+  The drives are simulated, so they work in parallel in simulated time: the
+  aggregate IOPS are the requests over the busy time of the slowest drive.
+*/
+static int simulate_multiq(const struct policy* p, const struct disk_model* m, size_t n,
+                           int n_devices, double* iops){
+    struct device_t devs[MQ_BENCH_MAX];
+    struct device_t* ptrs[MQ_BENCH_MAX];
+    int ready = 0;
+    while(ready < n_devices && dev_sim_init(&devs[ready], m, m->cylinders / 2, 1) == 0){
+        ptrs[ready] = &devs[ready];
+        ++ready;
+    }
+
+    int ret = -1;
+    int stripe = m->cylinders < MQ_BENCH_STRIPE ? m->cylinders : MQ_BENCH_STRIPE;
+    struct disk_multiq mq;
+    if(ready == n_devices && mq_init(&mq, ptrs, n_devices, p->run, stripe) == 0){
+        // whole stripe units only, so every block is on its drive
+        unsigned long long blocks = (unsigned long long)n_devices * (unsigned)(m->cylinders / stripe * stripe);
+        for(size_t i = 0; i < n; ++i){
+            long long block = (long long)(rng() % blocks);
+            while(mq_submit_striped(&mq, block) == -1)
+                sched_yield(); // queue full
+        }
+        mq_shutdown(&mq);
+        struct mq_stats s;
+        mq_stats(&mq, -1, &s);
+        double busy = 0;
+        for(int d = 0; d < n_devices; ++d)
+            if(devs[d].now_us > busy) busy = devs[d].now_us;
+        *iops = busy > 0 ? (double)s.completed / busy * 1e6 : 0.0;
+        if(!s.failed) ret = 0;
+        mq_destroy(&mq);
+    }
+    while(ready > 0)
+        dev_sim_free(&devs[--ready]);
+    return ret;
+}
+
+static void run_multiq(const struct disk_model* m, size_t n){
+    static const int drives[] = { 1, 2, 4, 8 };
+    printf("\nmulti-queue: %zu uniform requests striped over N drives, aggregate IOPS\n", n);
+    printf("%-7s", "policy");
+    for(size_t d = 0; d < sizeof(drives) / sizeof(drives[0]); ++d)
+        printf("       N=%d", drives[d]);
+    printf("\n");
+    for(size_t k = 0; k < sizeof(policies) / sizeof(policies[0]); ++k){
+        printf("%-7s", policies[k].name);
+        for(size_t d = 0; d < sizeof(drives) / sizeof(drives[0]); ++d){
+            double iops;
+            if(simulate_multiq(&policies[k], m, n, drives[d], &iops)) printf(" %9s", "-");
+            else printf(" %9.1f", iops);
+        }
+        printf("\n");
+    }
+}
+
+#ifdef METRICS
+static void print_metrics(void){
+    static struct metrics_snapshot s; // too big for the stack
+    metrics_snapshot(&s);
+    const struct metric_hist_data* seek = &s.hists[HIST_DISK_SEEK];
+    const struct metric_hist_data* depth = &s.hists[HIST_DISK_QUEUE_DEPTH];
+    printf("\nmetrics: %llu requests, %llu cylinders; seek p50 %llu p99 %llu max %llu",
+           (unsigned long long)s.counters[CNT_DISK_REQUESTS],
+           (unsigned long long)s.counters[CNT_DISK_CYLINDERS],
+           (unsigned long long)metrics_percentile(seek, 0.5),
+           (unsigned long long)metrics_percentile(seek, 0.99), (unsigned long long)seek->max);
+    if(depth->count)
+        printf("; queue depth p50 %llu p99 %llu",
+               (unsigned long long)metrics_percentile(depth, 0.5),
+               (unsigned long long)metrics_percentile(depth, 0.99));
+    printf("\n");
+}
+#endif
+
+int main(int argc, char** argv){
+    struct disk_model m;
+    disk_model_default(&m);
+    size_t n = 100000;
+    size_t depth = 128;
+    double mean = 8000;
+    const char* trace = NULL;
+    int multiq = 0;
+
+    int opt;
+    while((opt = getopt(argc, argv, "n:i:q:c:r:t:m")) != -1){
+        switch(opt){
+            case 'n': n = strtoul(optarg, NULL, 10); break;
+            case 'i': mean = atof(optarg); break;
+            case 'q': depth = strtoul(optarg, NULL, 10); break;
+            case 'c': m.cylinders = atoi(optarg); break;
+            case 'r': m.rpm = atof(optarg); break;
+            case 't': trace = optarg; break;
+            case 'm': multiq = 1; break;
+            default:
+                fprintf(stderr, "usage: %s [-n requests] [-i interarrival_us] [-q depth] "
+                        "[-c cylinders] [-r rpm] [-t trace] [-m]\n", argv[0]);
+                return 1;
+        }
+    }
+    if(n == 0 || depth == 0 || m.cylinders < 1 || m.rpm <= 0){
+        fprintf(stderr, "invalid parameters\n");
+        return 1;
+    }
+
+#ifdef METRICS
+    if(metrics_dump_on_signal(SIGUSR1) == -1)
+        perror("sigaction");
+#endif
+
+    printf("drive: %d cylinders, %.0f rpm, full seek %.2f ms; mean interarrival %.0f us, "
+           "queue depth %zu\n", m.cylinders, m.rpm, disk_seek_time(&m, m.cylinders - 1) / 1000,
+           mean, depth);
+
+    if(multiq){
+        run_multiq(&m, n);
+#ifdef METRICS
+        print_metrics();
+#endif
+        return 0;
+    }
+
+    int (*gen[])(struct workload*, size_t, int, double) = {
+        gen_uniform, gen_zipf, gen_sequential, gen_bursty,
+    };
+    for(size_t k = 0; k < sizeof(gen) / sizeof(gen[0]); ++k){
+        struct workload w;
+        if(gen[k](&w, n, m.cylinders, mean)){
+            fprintf(stderr, "out of memory\n");
+            return 1;
+        }
+        run_workload(&w, &m, depth);
+        workload_free(&w);
+    }
+
+    if(trace){
+        struct workload w;
+        if(load_trace(&w, trace, m.cylinders)){
+            perror(trace);
+            return 1;
+        }
+        if(w.n) run_workload(&w, &m, depth);
+        workload_free(&w);
+    }
+#ifdef METRICS
+    print_metrics();
+#endif
+    return 0;
+}
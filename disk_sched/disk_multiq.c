@@ -0,0 +1,245 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef DISK_SIM
+#include "disk_sim.h"
+#else
+#include "tasks_lib.h"
+#endif
+#include "disk_multiq.h"
+#include "../metrics/metrics.h"
+
+static void queue_init(struct mq_queue* q){
+    for(size_t i = 0; i < MQ_QUEUE_SIZE; ++i)
+        atomic_init(&q->slots[i].seq, i);
+    atomic_init(&q->head, 0);
+    atomic_init(&q->tail, 0);
+}
+
+// Any number of producers. Returns -1 if the queue is full.
+static int queue_push(struct mq_queue* q, int cylinder){
+    size_t pos = atomic_load_explicit(&q->head, memory_order_relaxed);
+    struct mq_slot* slot;
+    for(;;){
+        slot = &q->slots[pos & (MQ_QUEUE_SIZE - 1)];
+        size_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        intptr_t dif = (intptr_t)seq - (intptr_t)pos;
+        if(dif == 0){
+            if(atomic_compare_exchange_weak_explicit(&q->head, &pos, pos + 1,
+                                                     memory_order_relaxed, memory_order_relaxed))
+                break;
+        }else if(dif < 0){
+            return -1;
+        }else{
+            pos = atomic_load_explicit(&q->head, memory_order_relaxed);
+        }
+    }
+    slot->cylinder = cylinder;
+    atomic_store_explicit(&slot->seq, pos + 1, memory_order_release);
+    return 0;
+}
+
+// Only the worker of the queue pops. Returns -1 if the queue is empty.
+static int queue_pop(struct mq_queue* q, int* cylinder){
+    size_t pos = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    struct mq_slot* slot = &q->slots[pos & (MQ_QUEUE_SIZE - 1)];
+    if(atomic_load_explicit(&slot->seq, memory_order_acquire) != pos + 1)
+        return -1;
+    *cylinder = slot->cylinder;
+    atomic_store_explicit(&q->tail, pos + 1, memory_order_relaxed);
+    atomic_store_explicit(&slot->seq, pos + MQ_QUEUE_SIZE, memory_order_release);
+    return 0;
+}
+
+static int queue_empty(struct mq_queue* q){
+    size_t pos = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    struct mq_slot* slot = &q->slots[pos & (MQ_QUEUE_SIZE - 1)];
+    return atomic_load_explicit(&slot->seq, memory_order_acquire) != pos + 1;
+}
+
+static void* worker_main(void* arg){
+    struct mq_worker* w = arg;
+    struct disk_multiq* mq = w->mq;
+    int batch[MQ_MAX_BATCH];
+
+    for(;;){
+        int n = 0;
+        while(n < MQ_MAX_BATCH && queue_pop(&w->queue, &batch[n]) == 0)
+            ++n;
+        if(n){
+            // queue depth at dispatch: this batch plus what it left behind
+            METRIC_RECORD(HIST_DISK_QUEUE_DEPTH,
+                          (size_t)n + atomic_load_explicit(&w->queue.head, memory_order_relaxed)
+                                    - atomic_load_explicit(&w->queue.tail, memory_order_relaxed));
+            int dist = mq->policy(w->device, batch, n);
+            if(dist < 0){
+                atomic_fetch_add(&w->failed, (unsigned long)n);
+                continue;
+            }
+            atomic_fetch_add(&w->distance, (unsigned long long)dist);
+            atomic_fetch_add(&w->completed, (unsigned long)n);
+            atomic_fetch_add(&w->batches, 1);
+            continue;
+        }
+        // stop is only set once all submissions are done
+        if(atomic_load(&mq->stop)){
+            if(queue_empty(&w->queue)) break;
+            continue;
+        }
+
+        pthread_mutex_lock(&w->lock);
+        atomic_store(&w->sleeping, 1);
+        atomic_thread_fence(memory_order_seq_cst);
+        if(queue_empty(&w->queue) && !atomic_load(&mq->stop)){
+            struct timespec ts;
+            clock_gettime(CLOCK_REALTIME, &ts);
+            ts.tv_nsec += 10 * 1000 * 1000;
+            if(ts.tv_nsec >= 1000000000L){
+                ts.tv_sec++;
+                ts.tv_nsec -= 1000000000L;
+            }
+            pthread_cond_timedwait(&w->wake, &w->lock, &ts);
+        }
+        atomic_store(&w->sleeping, 0);
+        pthread_mutex_unlock(&w->lock);
+    }
+    return NULL;
+}
+
+static void worker_wake(struct mq_worker* w){
+    atomic_thread_fence(memory_order_seq_cst);
+    if(atomic_load(&w->sleeping)){
+        pthread_mutex_lock(&w->lock);
+        pthread_cond_signal(&w->wake);
+        pthread_mutex_unlock(&w->lock);
+    }
+}
+
+int mq_init(struct disk_multiq* mq, struct device_t* devices[], int n_devices,
+            int (*policy)(struct device_t*, int[], int), int stripe){
+    if(n_devices < 1 || !policy || stripe < 1)
+        return -1;
+    mq->workers = calloc((size_t)n_devices, sizeof(*mq->workers));
+    if(!mq->workers)
+        return -1;
+    mq->n_devices = n_devices;
+    mq->stripe = stripe;
+    mq->policy = policy;
+    atomic_init(&mq->stop, 0);
+    clock_gettime(CLOCK_MONOTONIC, &mq->started);
+
+    for(int i = 0; i < n_devices; ++i){
+        struct mq_worker* w = &mq->workers[i];
+        w->mq = mq;
+        w->id = i;
+        w->device = devices[i];
+        w->max_cylinder = dev_get_max_cylinder(devices[i]);
+        queue_init(&w->queue);
+        pthread_mutex_init(&w->lock, NULL);
+        pthread_cond_init(&w->wake, NULL);
+        atomic_init(&w->sleeping, 0);
+        atomic_init(&w->submitted, 0);
+        atomic_init(&w->rejected, 0);
+        atomic_init(&w->completed, 0);
+        atomic_init(&w->failed, 0);
+        atomic_init(&w->batches, 0);
+        atomic_init(&w->distance, 0);
+    }
+    for(int i = 0; i < n_devices; ++i){
+        if(pthread_create(&mq->workers[i].thread, NULL, worker_main, &mq->workers[i])){
+            int n = mq->n_devices;
+            mq->n_devices = i;
+            mq_shutdown(mq);
+            for(; i < n; ++i){
+                pthread_mutex_destroy(&mq->workers[i].lock);
+                pthread_cond_destroy(&mq->workers[i].wake);
+            }
+            mq_destroy(mq);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int mq_submit(struct disk_multiq* mq, int device, int cylinder){
+    if(device < 0 || device >= mq->n_devices)
+        return -1;
+    struct mq_worker* w = &mq->workers[device];
+    if(cylinder < 0 || cylinder > w->max_cylinder)
+        return -1;
+    if(queue_push(&w->queue, cylinder) == -1){
+        atomic_fetch_add_explicit(&w->rejected, 1, memory_order_relaxed);
+        return -1;
+    }
+    atomic_fetch_add_explicit(&w->submitted, 1, memory_order_relaxed);
+    worker_wake(w);
+    return 0;
+}
+
+int mq_submit_striped(struct disk_multiq* mq, long long block){
+    if(block < 0)
+        return -1;
+    long long unit = block / mq->stripe;
+    int device = (int)(unit % mq->n_devices);
+    long long cylinder = unit / mq->n_devices * mq->stripe + block % mq->stripe;
+    // past the end of the array; also keeps the cast below from truncating
+    if(cylinder > mq->workers[device].max_cylinder)
+        return -1;
+    return mq_submit(mq, device, (int)cylinder);
+}
+
+void mq_shutdown(struct disk_multiq* mq){
+    atomic_store(&mq->stop, 1);
+    for(int i = 0; i < mq->n_devices; ++i){
+        struct mq_worker* w = &mq->workers[i];
+        pthread_mutex_lock(&w->lock);
+        pthread_cond_signal(&w->wake);
+        pthread_mutex_unlock(&w->lock);
+    }
+    for(int i = 0; i < mq->n_devices; ++i)
+        pthread_join(mq->workers[i].thread, NULL);
+    for(int i = 0; i < mq->n_devices; ++i){
+        pthread_mutex_destroy(&mq->workers[i].lock);
+        pthread_cond_destroy(&mq->workers[i].wake);
+    }
+}
+
+void mq_destroy(struct disk_multiq* mq){
+    free(mq->workers);
+    mq->workers = NULL;
+    mq->n_devices = 0;
+}
+
+void mq_stats(struct disk_multiq* mq, int device, struct mq_stats* out){
+    memset(out, 0, sizeof(*out));
+    for(int i = 0; i < mq->n_devices; ++i){
+        if(device >= 0 && i != device) continue;
+        struct mq_worker* w = &mq->workers[i];
+        out->submitted += atomic_load(&w->submitted);
+        out->rejected += atomic_load(&w->rejected);
+        out->completed += atomic_load(&w->completed);
+        out->failed += atomic_load(&w->failed);
+        out->batches += atomic_load(&w->batches);
+        out->distance += atomic_load(&w->distance);
+    }
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    out->seconds = (double)(now.tv_sec - mq->started.tv_sec)
+                 + (double)(now.tv_nsec - mq->started.tv_nsec) / 1e9;
+}
+
+void mq_report(struct disk_multiq* mq, FILE* out){
+    struct mq_stats s;
+    fprintf(out, "dev  submitted  rejected  completed  failed  batches  avg batch  seek distance\n");
+    for(int i = 0; i < mq->n_devices; ++i){
+        mq_stats(mq, i, &s);
+        fprintf(out, "%3d  %9lu  %8lu  %9lu  %6lu  %7lu  %9.1f  %13llu\n", i, s.submitted, s.rejected,
+                s.completed, s.failed, s.batches, s.batches ? (double)s.completed / (double)s.batches : 0.0,
+                s.distance);
+    }
+    mq_stats(mq, -1, &s);
+    fprintf(out, "total %lu completed in %.3f s (%.0f requests/s), %llu cylinders\n", s.completed,
+            s.seconds, s.seconds > 0 ? (double)s.completed / s.seconds : 0.0, s.distance);
+    if(s.failed)
+        fprintf(out, "%lu requests failed (policy out of memory)\n", s.failed);
+}
@@ -0,0 +1,98 @@
+#ifndef DISK_MULTIQ_H__
+#define DISK_MULTIQ_H__
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <time.h>
+
+struct device_t;
+
+/*
+  Dispatcher for an array of devices. Every device has a worker thread and a
+  bounded lock-free submission queue (array of sequence-numbered slots, safe
+  for any number of producers). The worker drains its queue in batches and
+  hands each batch to the configured batch policy (FCFS, SSF, SCAN, ...), so
+  the devices work in parallel and never share a lock.
+*/
+#define MQ_QUEUE_SIZE 4096 // per device, power of two
+#define MQ_MAX_BATCH  256
+
+struct mq_slot {
+    atomic_size_t seq;
+    int cylinder;
+};
+
+struct mq_queue {
+    struct mq_slot slots[MQ_QUEUE_SIZE];
+    _Alignas(64) atomic_size_t head; // next slot to fill
+    _Alignas(64) atomic_size_t tail; // next slot to drain
+};
+
+struct disk_multiq;
+
+struct mq_worker {
+    struct disk_multiq* mq;
+    int id;
+    struct device_t* device;
+    int max_cylinder;         // of the device, read once by mq_init
+    pthread_t thread;
+    struct mq_queue queue;
+
+    pthread_mutex_t lock;     // only for sleeping while the queue is empty
+    pthread_cond_t wake;
+    atomic_int sleeping;
+
+    atomic_ulong submitted;
+    atomic_ulong rejected;    // submissions that found the queue full
+    atomic_ulong completed;
+    atomic_ulong failed;      // requests of batches the policy failed (-1)
+    atomic_ulong batches;     // completed batches
+    atomic_ullong distance;   // cylinders travelled
+};
+
+struct disk_multiq {
+    int n_devices;
+    int stripe;               // cylinders per stripe unit
+    int (*policy)(struct device_t* device, int requests[], int size);
+    struct mq_worker* workers;
+    atomic_bool stop;
+    struct timespec started;
+};
+
+struct mq_stats {
+    unsigned long submitted;
+    unsigned long rejected;
+    unsigned long completed;
+    unsigned long failed;
+    unsigned long batches;
+    unsigned long long distance;
+    double seconds;           // since mq_init
+};
+
+// Starts one worker per device; returns 0 on success
+int mq_init(struct disk_multiq* mq, struct device_t* devices[], int n_devices,
+            int (*policy)(struct device_t*, int[], int), int stripe);
+
+// Queues a request for one device; returns -1 if its queue is full or the
+// cylinder is not on the device
+int mq_submit(struct disk_multiq* mq, int device, int cylinder);
+
+// Queues a request by its position in the striped array: stripe units of
+// `stripe` cylinders go round-robin over the devices. Returns -1 if full or
+// if the block maps past the last cylinder of its device.
+int mq_submit_striped(struct disk_multiq* mq, long long block);
+
+// Completes all queued requests and stops the workers. The counters stay
+// readable until mq_destroy.
+void mq_shutdown(struct disk_multiq* mq);
+void mq_destroy(struct disk_multiq* mq);
+
+// Sums up the counters of all devices (or of one if device >= 0)
+void mq_stats(struct disk_multiq* mq, int device, struct mq_stats* out);
+
+// Prints per-device and total statistics
+void mq_report(struct disk_multiq* mq, FILE* out);
+
+#endif // DISK_MULTIQ_H__
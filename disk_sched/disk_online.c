@@ -0,0 +1,168 @@
+#include <stdlib.h>
+#include <string.h>
+#ifdef DISK_SIM
+#include "disk_sim.h"
+#else
+#include "tasks_lib.h"
+#endif
+#include "disk_online.h"
+#include "../metrics/metrics.h"
+
+// sign = +1 orders the heap by ascending cylinder, -1 by descending cylinder.
+// Equal cylinders are served in arrival order.
+static int req_before(const struct disk_request* a, const struct disk_request* b, int sign){
+    if(a->cylinder != b->cylinder)
+        return sign * (a->cylinder - b->cylinder) < 0;
+    return a->arrival < b->arrival;
+}
+
+static int heap_push(struct request_heap* h, struct disk_request r, int sign){
+    if(h->n == h->cap){
+        size_t cap = h->cap ? 2 * h->cap : 64;
+        struct disk_request* req = realloc(h->req, cap * sizeof(*req));
+        if(req == NULL) return -1;
+        h->req = req;
+        h->cap = cap;
+    }
+    size_t i = h->n++;
+    while(i > 0 && req_before(&r, &h->req[(i-1)/2], sign)){
+        h->req[i] = h->req[(i-1)/2];
+        i = (i-1)/2;
+    }
+    h->req[i] = r;
+    return 0;
+}
+
+static struct disk_request heap_pop(struct request_heap* h, int sign){
+    struct disk_request top = h->req[0];
+    struct disk_request last = h->req[--h->n];
+    size_t i = 0;
+    for(;;){
+        size_t c = 2*i + 1;
+        if(c >= h->n) break;
+        if(c+1 < h->n && req_before(&h->req[c+1], &h->req[c], sign)) ++c;
+        if(!req_before(&h->req[c], &last, sign)) break;
+        h->req[i] = h->req[c];
+        i = c;
+    }
+    if(h->n) h->req[i] = last;
+    return top;
+}
+
+int disk_online_init(struct disk_online* s, struct device_t* device){
+    memset(s, 0, sizeof(*s));
+    s->device = device;
+    s->going_up = (int) dev_get_direction(device) > 0;
+    return 0;
+}
+
+void disk_online_destroy(struct disk_online* s){
+    free(s->up.req);
+    free(s->down.req);
+    free(s->latency);
+    memset(s, 0, sizeof(*s));
+}
+
+int disk_online_submit(struct disk_online* s, int cylinder, long long arrival_time){
+    struct disk_request r = { cylinder, arrival_time };
+    int head = dev_get_cylinder(s->device);
+    if(cylinder > head || (cylinder == head && s->going_up))
+        return heap_push(&s->up, r, +1);
+    return heap_push(&s->down, r, -1);
+}
+
+size_t disk_online_pending(struct disk_online* s){
+    return s->up.n + s->down.n;
+}
+
+int disk_online_next(struct disk_online* s){
+    size_t pending = disk_online_pending(s);
+    if(!pending)
+        return -1;
+    if(s->going_up ? !s->up.n : !s->down.n){
+        s->going_up = !s->going_up;
+        dev_switch_direction(s->device);
+    }
+    struct disk_request r = s->going_up ? heap_pop(&s->up, +1) : heap_pop(&s->down, -1);
+
+    if(s->n_served == s->cap_served){
+        size_t cap = s->cap_served ? 2 * s->cap_served : 1024;
+        long long* lat = realloc(s->latency, cap * sizeof(*lat));
+        if(lat == NULL){
+            // keep the request, the caller may retry
+            if(s->going_up) heap_push(&s->up, r, +1);
+            else            heap_push(&s->down, r, -1);
+            return -1;
+        }
+        s->latency = lat;
+        s->cap_served = cap;
+    }
+
+    int diff = r.cylinder - dev_get_cylinder(s->device);
+    if(diff < 0) diff = -diff;
+    dev_move_to_cylinder(s->device, r.cylinder);
+    dev_work(s->device);
+    s->total_seek += diff;
+    s->now += diff + ONLINE_SERVICE_TIME;
+    s->latency[s->n_served++] = s->now - r.arrival;
+    METRIC_INC(CNT_DISK_REQUESTS);
+    METRIC_ADD(CNT_DISK_CYLINDERS, diff);
+    METRIC_RECORD(HIST_DISK_SEEK, diff);
+    METRIC_RECORD(HIST_DISK_QUEUE_DEPTH, pending);
+    return r.cylinder;
+}
+
+void disk_online_idle_until(struct disk_online* s, long long t){
+    if(t > s->now)
+        s->now = t;
+}
+
+int disk_online_replay(struct disk_online* s, const int cylinders[], const long long arrivals[], size_t n){
+    size_t i = 0;
+    while(i < n || disk_online_pending(s)){
+        while(i < n && arrivals[i] <= s->now){
+            if(disk_online_submit(s, cylinders[i], arrivals[i]) == -1)
+                return -1;
+            ++i;
+        }
+        if(!disk_online_pending(s)){
+            disk_online_idle_until(s, arrivals[i]);
+            continue;
+        }
+        if(disk_online_next(s) == -1)
+            return -1;
+    }
+    return 0;
+}
+
+static int cmp_ll(const void* a, const void* b){
+    long long x = *(const long long*)a;
+    long long y = *(const long long*)b;
+    return (x > y) - (x < y);
+}
+
+long long disk_online_percentile(struct disk_online* s, double p){
+    if(!s->n_served)
+        return -1;
+    // the order of the latencies does not matter for anything else
+    if(s->n_sorted != s->n_served){
+        qsort(s->latency, s->n_served, sizeof(*s->latency), cmp_ll);
+        s->n_sorted = s->n_served;
+    }
+    if(p <= 0) return s->latency[0];
+    if(p >= 100) return s->latency[s->n_served - 1];
+    size_t rank = (size_t)(p / 100.0 * (double)s->n_served);
+    if(rank >= s->n_served) rank = s->n_served - 1;
+    return s->latency[rank];
+}
+
+void disk_online_report(struct disk_online* s, FILE* out){
+    fprintf(out, "served %zu, pending %zu, total seek %lld, time %lld\n",
+            s->n_served, disk_online_pending(s), s->total_seek, s->now);
+    if(!s->n_served)
+        return;
+    fprintf(out, "latency p50 %lld  p90 %lld  p99 %lld  p99.9 %lld  max %lld\n",
+            disk_online_percentile(s, 50), disk_online_percentile(s, 90),
+            disk_online_percentile(s, 99), disk_online_percentile(s, 99.9),
+            disk_online_percentile(s, 100));
+}
@@ -0,0 +1,74 @@
+#ifndef DISK_ONLINE_H__
+#define DISK_ONLINE_H__
+
+#include <stddef.h>
+#include <stdio.h>
+
+struct device_t;
+
+/*
+  Online elevator (LOOK) scheduler for requests that arrive while the head is
+  moving. Pending requests above the head sit in a min-heap, requests below it
+  in a max-heap, so submit and next are O(log n).
+
+  Time advances by one unit per cylinder travelled plus ONLINE_SERVICE_TIME
+  per served request. The latency of a request is its completion time minus
+  its arrival time.
+*/
+#define ONLINE_SERVICE_TIME 1
+
+struct disk_request {
+    int cylinder;
+    long long arrival;
+};
+
+struct request_heap {
+    struct disk_request* req;
+    size_t n;
+    size_t cap;
+};
+
+struct disk_online {
+    struct device_t* device;
+    struct request_heap up;   // min-heap, cylinder >= head
+    struct request_heap down; // max-heap, cylinder <= head
+    int going_up;
+    long long now;
+    long long total_seek;
+
+    long long* latency;       // latency of every served request
+    size_t n_served;
+    size_t cap_served;
+    size_t n_sorted;          // latency[0, n_sorted) is sorted
+};
+
+// Initializes the scheduler for device; returns 0 on success
+int disk_online_init(struct disk_online* s, struct device_t* device);
+
+// Frees all memory of the scheduler (not the device)
+void disk_online_destroy(struct disk_online* s);
+
+// Queues a request; returns 0 on success, -1 if out of memory
+int disk_online_submit(struct disk_online* s, int cylinder, long long arrival_time);
+
+// Number of pending requests
+size_t disk_online_pending(struct disk_online* s);
+
+// Moves the head to the next request in elevator order and serves it.
+// Returns the cylinder, -1 if nothing is pending.
+int disk_online_next(struct disk_online* s);
+
+// Lets the clock run forward to t while the disk is idle
+void disk_online_idle_until(struct disk_online* s, long long t);
+
+// Replays n requests sorted by arrival time: every request is submitted as soon
+// as the clock reaches its arrival time. Returns 0 on success.
+int disk_online_replay(struct disk_online* s, const int cylinders[], const long long arrivals[], size_t n);
+
+// Latency of the p-th percentile (0..100) of all served requests, -1 if none
+long long disk_online_percentile(struct disk_online* s, double p);
+
+// Prints served requests, total seek distance and latency percentiles
+void disk_online_report(struct disk_online* s, FILE* out);
+
+#endif // DISK_ONLINE_H__
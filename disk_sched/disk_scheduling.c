@@ -1,10 +1,21 @@
 #include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
+#ifdef DISK_SIM
+#include "disk_sim.h"
+#else
 #include "tasks_lib.h"
+#endif
+#include "disk_scheduling.h"
 
 #ifdef VPL
 #include "tasks.h"
 #endif
+#include "../metrics/metrics.h"
+
+// Accounts one head movement of d cylinders
+#define SEEK_METRIC(d) (METRIC_ADD(CNT_DISK_CYLINDERS, (d)), METRIC_RECORD(HIST_DISK_SEEK, (d)))
 
 
 int FCFS(struct device_t* device, int requests[], int size){
@@ -16,45 +27,139 @@ int FCFS(struct device_t* device, int requests[], int size){
       int diff = target - cur;
       if(diff<0) diff = -diff;
       total += diff;
+      SEEK_METRIC(diff);
       dev_move_to_cylinder(device, target);
       dev_work(device);
+      METRIC_INC(CNT_DISK_REQUESTS);
       cur = target;
   }
   return total;
 }
 
+/*
+  Sorts cylinder numbers in O(n + C), where C is the spread of the values.
+  Spreads up to n use a counting sort, so its histogram never outgrows the
+  input. If the spread is small enough for four histograms to stay in cache,
+  the histogram is split into four interleaved tables so consecutive
+  increments don't depend on each other, and the tables are summed in a
+  vectorizable loop. Larger spreads use an LSD radix sort with 16-bit digits.
+  Returns -1 if memory runs out.
+*/
+#define RADIX_BITS 16
+#define RADIX (1u << RADIX_BITS)
+#define COUNT_SPLIT_MAX 4096
+
+static int sort_cylinders(int *a, int n){
+  if(n < 2) return 0;
+
+  int min = a[0], max = a[0];
+  for(int i = 1; i < n; ++i){
+      if(a[i] < min) min = a[i];
+      if(a[i] > max) max = a[i];
+  }
+  size_t range = (size_t)((long long)max - min) + 1;
+
+  if(range <= (size_t)n){
+      size_t ways = range <= COUNT_SPLIT_MAX ? 4 : 1;
+      unsigned *cnt = calloc(ways * range, sizeof(unsigned));
+      if(cnt == NULL) return -1;
+      unsigned *c0 = cnt;
+      int i = 0;
+      if(ways == 4){
+          unsigned *c1 = cnt + range, *c2 = cnt + 2*range, *c3 = cnt + 3*range;
+          for(; i + 4 <= n; i += 4){
+              c0[a[i]   - min]++;
+              c1[a[i+1] - min]++;
+              c2[a[i+2] - min]++;
+              c3[a[i+3] - min]++;
+          }
+          for(size_t v = 0; v < range; ++v) c0[v] += c1[v] + c2[v] + c3[v];
+      }
+      for(; i < n; ++i) c0[a[i] - min]++;
+
+      int k = 0;
+      for(size_t v = 0; v < range; ++v)
+          for(unsigned c = c0[v]; c > 0; --c)
+              a[k++] = (int)(min + (long long)v);
+      free(cnt);
+      return 0;
+  }
+
+  unsigned *keys = malloc(sizeof(unsigned) * (size_t)n);
+  unsigned *tmp = malloc(sizeof(unsigned) * (size_t)n);
+  size_t *cnt = malloc(sizeof(size_t) * RADIX);
+  if(keys == NULL || tmp == NULL || cnt == NULL){
+      free(keys); free(tmp); free(cnt);
+      return -1;
+  }
+  for(int i = 0; i < n; ++i) keys[i] = (unsigned)((long long)a[i] - min);
+
+  for(unsigned shift = 0; shift < 32 && ((range - 1) >> shift); shift += RADIX_BITS){
+      memset(cnt, 0, sizeof(size_t) * RADIX);
+      for(int i = 0; i < n; ++i) cnt[(keys[i] >> shift) & (RADIX - 1)]++;
+      size_t sum = 0;
+      for(size_t d = 0; d < RADIX; ++d){
+          size_t c = cnt[d];
+          cnt[d] = sum;
+          sum += c;
+      }
+      for(int i = 0; i < n; ++i) tmp[cnt[(keys[i] >> shift) & (RADIX - 1)]++] = keys[i];
+      unsigned *t = keys; keys = tmp; tmp = t;
+  }
+
+  for(int i = 0; i < n; ++i) a[i] = (int)(min + (long long)keys[i]);
+  free(keys); free(tmp); free(cnt);
+  return 0;
+}
+
+/*
+  The requests that SSF has served always form a contiguous range of the
+  sorted requests: the nearest unserved request is either the closest one
+  left or the closest one right of that range. Sorting once and sweeping
+  two pointers outwards makes SSF O(n log n) instead of O(n^2).
+*/
 int SSF(struct device_t* device, int requests[], int size){
   int total = 0;
   int cur = dev_get_cylinder(device);
-  
-  int served[size];
-  for(int i = 0; i < size; ++i) served[i] = 0;
-  
-  int completed = 0;
-  while(completed < size){
-      int best = -1;
-      int best_dist = 0;
-      
-      for(int i=0;i<size;++i){
-          if(served[i]) continue;
-          int d = requests[i] - cur;
-          if(d<0) d = -d;
-          
-          if(best==-1 || d<best_dist || (d==best_dist && requests[i] < requests[best])){
-              best = i;
-              best_dist = d;
-          }
-      }
-      
-      int target = requests[best];
-      total += best_dist;
+  if(size <= 0) return 0;
+
+  int *sorted = malloc(sizeof(int) * (size_t)size);
+  if(sorted == NULL) return -1;
+  memcpy(sorted, requests, sizeof(int) * (size_t)size);
+  if(sort_cylinders(sorted, size) == -1){
+      free(sorted);
+      return -1;
+  }
+
+  // right = first request above cur, left = the one below it
+  int lo = 0, hi = size;
+  while(lo < hi){
+      int mid = lo + (hi - lo) / 2;
+      if(sorted[mid] <= cur) lo = mid + 1;
+      else hi = mid;
+  }
+  int left = lo - 1;
+  int right = lo;
+
+  while(left >= 0 || right < size){
+      int target;
+      // on a tie the lower cylinder wins
+      if(right >= size || (left >= 0 && cur - sorted[left] <= sorted[right] - cur))
+          target = sorted[left--];
+      else
+          target = sorted[right++];
+
+      int diff = target - cur;
+      if(diff<0) diff = -diff;
+      total += diff;
+      SEEK_METRIC(diff);
       dev_move_to_cylinder(device,target);
       dev_work(device);
+      METRIC_INC(CNT_DISK_REQUESTS);
       cur = target;
-      
-      served[best] = 1;
-      ++completed;
   }
+
+  free(sorted);
   return total;
 }
 
@@ -66,16 +171,12 @@ int SCAN(struct device_t* device, int requests[], int size){
     int dir_val = (int) dev_get_direction(device);
     int going_up = dir_val > 0;
     
-    int sorted[size];
-    for(int i = 0; i < size; ++i) sorted[i] = requests[i];
-    for(int i = 0; i < size; ++i){
-        int key = sorted[i];
-        int j = i-1;
-        while(j >= 0 && sorted[j] > key){
-            sorted[j+1] = sorted[j];
-            --j;
-        }
-        sorted[j+1] = key;
+    int *sorted = malloc(sizeof(int) * (size_t)(size > 0 ? size : 1));
+    if(sorted == NULL) return -1;
+    if(size > 0) memcpy(sorted, requests, sizeof(int) * (size_t)size);
+    if(sort_cylinders(sorted, size) == -1){
+        free(sorted);
+        return -1;
     }
     
     if(going_up){
@@ -83,8 +184,10 @@ int SCAN(struct device_t* device, int requests[], int size){
             if(sorted[i] >= cur){
                 int diff = sorted[i] - cur;
                 total += diff;
+                SEEK_METRIC(diff);
                 dev_move_to_cylinder(device, sorted[i]);
                 dev_work(device);
+                METRIC_INC(CNT_DISK_REQUESTS);
                 cur = sorted[i];
             }
         }
@@ -92,6 +195,7 @@ int SCAN(struct device_t* device, int requests[], int size){
         if(cur != maxc){
             int diff = maxc - cur;
             total += diff;
+            SEEK_METRIC(diff);
             dev_move_to_cylinder(device, maxc);
             cur = maxc;
         }
@@ -102,8 +206,10 @@ int SCAN(struct device_t* device, int requests[], int size){
             if(sorted[i] < start_pos){
                 int diff = cur - sorted[i];
                 total += diff;
+                SEEK_METRIC(diff);
                 dev_move_to_cylinder(device, sorted[i]);
                 dev_work(device);
+                METRIC_INC(CNT_DISK_REQUESTS);
                 cur = sorted[i];
             }
         }
@@ -113,14 +219,17 @@ int SCAN(struct device_t* device, int requests[], int size){
             if(sorted[i] <= cur){
                 int diff = cur - sorted[i];
                 total += diff;
+                SEEK_METRIC(diff);
                 dev_move_to_cylinder(device, sorted[i]);
                 dev_work(device);
+                METRIC_INC(CNT_DISK_REQUESTS);
                 cur = sorted[i];
             }
         }
         
         if(cur != 0){
             total += cur;
+            SEEK_METRIC(cur);
             dev_move_to_cylinder(device, 0);
             cur = 0;
         }
@@ -130,12 +239,299 @@ int SCAN(struct device_t* device, int requests[], int size){
             if(sorted[i] > start_pos){
                 int diff = sorted[i] - cur;
                 total += diff;
+                SEEK_METRIC(diff);
                 dev_move_to_cylinder(device, sorted[i]);
                 dev_work(device);
+                METRIC_INC(CNT_DISK_REQUESTS);
                 cur = sorted[i];
             }
         }
     }
     
+    free(sorted);
     return total;
 } 
+
+// Moves the head to target and serves the request there. Returns the distance.
+static int visit(struct device_t* device, int* cur, int target){
+    int diff = target - *cur;
+    if(diff < 0) diff = -diff;
+    SEEK_METRIC(diff);
+    dev_move_to_cylinder(device, target);
+    dev_work(device);
+    METRIC_INC(CNT_DISK_REQUESTS);
+    *cur = target;
+    return diff;
+}
+
+// Moves the head to target without serving anything. Returns the distance.
+static int travel(struct device_t* device, int* cur, int target){
+    int diff = target - *cur;
+    if(diff < 0) diff = -diff;
+    SEEK_METRIC(diff);
+    dev_move_to_cylinder(device, target);
+    *cur = target;
+    return diff;
+}
+
+// Returns a sorted heap copy of requests, NULL if out of memory
+static int* sorted_copy(int requests[], int size){
+    int *sorted = malloc(sizeof(int) * (size_t)(size > 0 ? size : 1));
+    if(sorted == NULL) return NULL;
+    if(size > 0) memcpy(sorted, requests, sizeof(int) * (size_t)size);
+    if(sort_cylinders(sorted, size) == -1){
+        free(sorted);
+        return NULL;
+    }
+    return sorted;
+}
+
+// Index of the first request >= cyl in sorted
+static int lower_bound(int sorted[], int size, int cyl){
+    int lo = 0, hi = size;
+    while(lo < hi){
+        int mid = lo + (hi - lo) / 2;
+        if(sorted[mid] < cyl) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+/*
+  LOOK: like SCAN, but the head only travels as far as the last request in
+  its direction before it turns around.
+*/
+int LOOK(struct device_t* device, int requests[], int size){
+    int total = 0;
+    int cur = dev_get_cylinder(device);
+    int going_up = (int) dev_get_direction(device) > 0;
+
+    int *sorted = sorted_copy(requests, size);
+    if(sorted == NULL) return -1;
+
+    if(going_up){
+        int split = lower_bound(sorted, size, cur);
+        for(int i = split; i < size; ++i)
+            total += visit(device, &cur, sorted[i]);
+        if(split > 0){
+            dev_switch_direction(device);
+            for(int i = split-1; i >= 0; --i)
+                total += visit(device, &cur, sorted[i]);
+        }
+    }else{
+        int split = lower_bound(sorted, size, cur + 1);
+        for(int i = split-1; i >= 0; --i)
+            total += visit(device, &cur, sorted[i]);
+        if(split < size){
+            dev_switch_direction(device);
+            for(int i = split; i < size; ++i)
+                total += visit(device, &cur, sorted[i]);
+        }
+    }
+
+    free(sorted);
+    return total;
+}
+
+/*
+  C-SCAN: serves requests in one direction only. At the end of the disk the
+  head returns to the other end without serving and sweeps again. The return
+  seek counts towards the total distance.
+*/
+int C_SCAN(struct device_t* device, int requests[], int size){
+    int total = 0;
+    int cur = dev_get_cylinder(device);
+    const int maxc = dev_get_max_cylinder(device);
+    int going_up = (int) dev_get_direction(device) > 0;
+
+    int *sorted = sorted_copy(requests, size);
+    if(sorted == NULL) return -1;
+
+    if(going_up){
+        int split = lower_bound(sorted, size, cur);
+        for(int i = split; i < size; ++i)
+            total += visit(device, &cur, sorted[i]);
+        if(cur != maxc)
+            total += travel(device, &cur, maxc);
+        if(split > 0){
+            total += travel(device, &cur, 0);
+            for(int i = 0; i < split; ++i)
+                total += visit(device, &cur, sorted[i]);
+        }
+    }else{
+        int split = lower_bound(sorted, size, cur + 1);
+        for(int i = split-1; i >= 0; --i)
+            total += visit(device, &cur, sorted[i]);
+        if(cur != 0)
+            total += travel(device, &cur, 0);
+        if(split < size){
+            total += travel(device, &cur, maxc);
+            for(int i = size-1; i >= split; --i)
+                total += visit(device, &cur, sorted[i]);
+        }
+    }
+
+    free(sorted);
+    return total;
+}
+
+/*
+  C-LOOK: like C-SCAN, but the head turns at the last request in its direction
+  and jumps straight to the farthest request on the other side.
+*/
+int C_LOOK(struct device_t* device, int requests[], int size){
+    int total = 0;
+    int cur = dev_get_cylinder(device);
+    int going_up = (int) dev_get_direction(device) > 0;
+
+    int *sorted = sorted_copy(requests, size);
+    if(sorted == NULL) return -1;
+
+    if(going_up){
+        int split = lower_bound(sorted, size, cur);
+        for(int i = split; i < size; ++i)
+            total += visit(device, &cur, sorted[i]);
+        for(int i = 0; i < split; ++i)
+            total += visit(device, &cur, sorted[i]);
+    }else{
+        int split = lower_bound(sorted, size, cur + 1);
+        for(int i = split-1; i >= 0; --i)
+            total += visit(device, &cur, sorted[i]);
+        for(int i = size-1; i >= split; --i)
+            total += visit(device, &cur, sorted[i]);
+    }
+
+    free(sorted);
+    return total;
+}
+
+/*
+  Deadline-aware LOOK. Request i expires at deadlines[i]. Time advances by one
+  per cylinder travelled plus DEADLINE_SERVICE_TIME per served request. While
+  no request has expired the head sweeps like LOOK; otherwise it serves the
+  expired request with the earliest deadline first, so far cylinders cannot
+  starve. The unserved requests form a doubly-linked list in cylinder order
+  and the deadlines sit in a min-heap, so every pick is O(log n).
+  If missed is not NULL, it receives the number of requests served late.
+*/
+#define DEADLINE_SERVICE_TIME 1
+
+static int cmp_u64(const void *a, const void *b){
+    unsigned long long x = *(const unsigned long long*)a;
+    unsigned long long y = *(const unsigned long long*)b;
+    return (x > y) - (x < y);
+}
+
+struct dl_heap {
+    long long *key;  // deadline
+    int *pos;        // position in cylinder order
+    int n;
+};
+
+static void dl_push(struct dl_heap *h, long long key, int pos){
+    int i = h->n++;
+    while(i > 0 && h->key[(i-1)/2] > key){
+        h->key[i] = h->key[(i-1)/2];
+        h->pos[i] = h->pos[(i-1)/2];
+        i = (i-1)/2;
+    }
+    h->key[i] = key;
+    h->pos[i] = pos;
+}
+
+static void dl_pop(struct dl_heap *h){
+    long long key = h->key[--h->n];
+    int pos = h->pos[h->n];
+    int i = 0;
+    for(;;){
+        int c = 2*i + 1;
+        if(c >= h->n) break;
+        if(c+1 < h->n && h->key[c+1] < h->key[c]) ++c;
+        if(h->key[c] >= key) break;
+        h->key[i] = h->key[c];
+        h->pos[i] = h->pos[c];
+        i = c;
+    }
+    h->key[i] = key;
+    h->pos[i] = pos;
+}
+
+int LOOK_deadline(struct device_t* device, int requests[], long long deadlines[], int size, int* missed){
+    int total = 0;
+    int late = 0;
+    int cur = dev_get_cylinder(device);
+    int going_up = (int) dev_get_direction(device) > 0;
+    long long now = 0;
+    if(missed) *missed = 0;
+    if(size <= 0) return 0;
+
+    size_t n = (size_t)size;
+    unsigned long long *order = malloc(sizeof(*order) * n);
+    int *cyl = malloc(sizeof(int) * n);
+    int *prev = malloc(sizeof(int) * n);
+    int *next = malloc(sizeof(int) * n);
+    long long *dl = malloc(sizeof(long long) * n);
+    char *served = calloc(n, 1);
+    struct dl_heap heap = { malloc(sizeof(long long) * n), malloc(sizeof(int) * n), 0 };
+    if(!order || !cyl || !prev || !next || !dl || !served || !heap.key || !heap.pos){
+        free(order); free(cyl); free(prev); free(next); free(dl); free(served);
+        free(heap.key); free(heap.pos);
+        return -1;
+    }
+
+    // cylinder in the high word keeps equal cylinders in request order
+    for(int i = 0; i < size; ++i)
+        order[i] = (unsigned long long)(unsigned)requests[i] << 32 | (unsigned)i;
+    qsort(order, n, sizeof(*order), cmp_u64);
+    for(int p = 0; p < size; ++p){
+        int i = (int)(order[p] & 0xffffffffu);
+        cyl[p] = requests[i];
+        dl[p] = deadlines[i];
+        prev[p] = p - 1;
+        next[p] = p + 1 < size ? p + 1 : -1;
+        dl_push(&heap, deadlines[i], p);
+    }
+    free(order);
+
+    // nearest unserved request at or above / below the head
+    int up = lower_bound(cyl, size, cur);
+    int down = up - 1;
+    if(up == size) up = -1;
+
+    for(int done = 0; done < size; ++done){
+        while(served[heap.pos[0]]) dl_pop(&heap);
+
+        int p;
+        if(heap.key[0] <= now){
+            p = heap.pos[0];
+        }else if(up >= 0 && cyl[up] == cur){
+            p = up;
+        }else{
+            if(going_up ? up < 0 : down < 0){
+                going_up = !going_up;
+                dev_switch_direction(device);
+            }
+            p = going_up ? up : down;
+        }
+        if((cyl[p] > cur && !going_up) || (cyl[p] < cur && going_up)){
+            going_up = !going_up;
+            dev_switch_direction(device);
+        }
+
+        int dist = visit(device, &cur, cyl[p]);
+        total += dist;
+        now += dist + DEADLINE_SERVICE_TIME;
+        if(dl[p] < now) ++late;
+
+        served[p] = 1;
+        if(prev[p] >= 0) next[prev[p]] = next[p];
+        if(next[p] >= 0) prev[next[p]] = prev[p];
+        up = next[p];
+        down = prev[p];
+    }
+
+    free(cyl); free(prev); free(next); free(dl); free(served);
+    free(heap.key); free(heap.pos);
+    if(missed) *missed = late;
+    return total;
+}
@@ -0,0 +1,16 @@
+#ifndef DISK_SCHEDULING_H__
+#define DISK_SCHEDULING_H__
+
+struct device_t;
+
+// Batch policies: serve all requests and return the total seek distance in
+// cylinders, -1 if out of memory.
+int FCFS(struct device_t* device, int requests[], int size);
+int SSF(struct device_t* device, int requests[], int size);
+int SCAN(struct device_t* device, int requests[], int size);
+int LOOK(struct device_t* device, int requests[], int size);
+int C_SCAN(struct device_t* device, int requests[], int size);
+int C_LOOK(struct device_t* device, int requests[], int size);
+int LOOK_deadline(struct device_t* device, int requests[], long long deadlines[], int size, int* missed);
+
+#endif // DISK_SCHEDULING_H__
@@ -0,0 +1,118 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "disk_sim.h"
+
+void disk_model_default(struct disk_model* m){
+    m->cylinders = 10000;
+    m->rpm = 7200;
+    m->spt_outer = 1200;
+    m->spt_inner = 600;
+    m->request_sectors = 8;
+    m->settle_us = 500;
+    m->seek_sqrt_us = 90;
+    m->seek_linear_us = 1.2;
+    m->seek_knee = 400;
+}
+
+double disk_seek_time(const struct disk_model* m, int distance){
+    if(distance < 0) distance = -distance;
+    if(distance == 0) return 0;
+    if(distance <= m->seek_knee)
+        return m->settle_us + m->seek_sqrt_us * sqrt((double)distance);
+    return m->settle_us + m->seek_sqrt_us * sqrt((double)m->seek_knee)
+         + m->seek_linear_us * (double)(distance - m->seek_knee);
+}
+
+int dev_sim_init(struct device_t* device, const struct disk_model* m, int cylinder, int direction){
+    memset(device, 0, sizeof(*device));
+    device->model = *m;
+    device->cylinder = cylinder;
+    device->direction = direction > 0 ? 1 : -1;
+    device->visits = calloc((size_t)m->cylinders, sizeof(*device->visits));
+    return device->visits ? 0 : -1;
+}
+
+void dev_sim_free(struct device_t* device){
+    free(device->visits);
+    free(device->served);
+    free(device->completion);
+    memset(device, 0, sizeof(*device));
+}
+
+void dev_sim_clear_log(struct device_t* device){
+    device->n_served = 0;
+}
+
+void dev_sim_idle_until(struct device_t* device, double t_us){
+    if(t_us > device->now_us)
+        device->now_us = t_us;
+}
+
+int dev_get_cylinder(struct device_t* device){
+    return device->cylinder;
+}
+
+int dev_get_max_cylinder(struct device_t* device){
+    return device->model.cylinders - 1;
+}
+
+int dev_get_direction(struct device_t* device){
+    return device->direction;
+}
+
+void dev_switch_direction(struct device_t* device){
+    device->direction = -device->direction;
+}
+
+void dev_move_to_cylinder(struct device_t* device, int cylinder){
+    if(cylinder < 0) cylinder = 0;
+    if(cylinder >= device->model.cylinders) cylinder = device->model.cylinders - 1;
+    double t = disk_seek_time(&device->model, cylinder - device->cylinder);
+    device->seek_us += t;
+    device->now_us += t;
+    device->cylinder = cylinder;
+}
+
+// Sectors per track of a cylinder (linear zoning from outer to inner)
+static int sectors_per_track(const struct disk_model* m, int cylinder){
+    if(m->cylinders <= 1) return m->spt_outer;
+    return m->spt_outer - (int)((long long)(m->spt_outer - m->spt_inner) * cylinder / (m->cylinders - 1));
+}
+
+void dev_work(struct device_t* device){
+    const struct disk_model* m = &device->model;
+    int c = device->cylinder;
+    int spt = sectors_per_track(m, c);
+    double rev_us = 60e6 / m->rpm;
+
+    // the k-th request to a cylinder starts where the (k-1)-th one ended, so
+    // sequential requests follow each other on the track
+    unsigned k = device->visits[c]++;
+    unsigned h = (unsigned)c * 2654435761u;
+    int sector = (int)((h % (unsigned)spt + (unsigned long long)k * (unsigned)m->request_sectors) % (unsigned)spt);
+
+    double angle = fmod(device->now_us / rev_us, 1.0);
+    double target = (double)sector / spt;
+    double wait = target - angle;
+    if(wait < 0) wait += 1.0;
+    double rot = wait * rev_us;
+    double xfer = (double)m->request_sectors / spt * rev_us;
+
+    device->rotation_us += rot;
+    device->transfer_us += xfer;
+    device->now_us += rot + xfer;
+
+    if(device->n_served == device->cap_served){
+        size_t cap = device->cap_served ? 2 * device->cap_served : 1024;
+        int* served = realloc(device->served, cap * sizeof(*served));
+        if(served) device->served = served;
+        double* completion = realloc(device->completion, cap * sizeof(*completion));
+        if(completion) device->completion = completion;
+        if(!served || !completion) return;
+        device->cap_served = cap;
+    }
+    device->served[device->n_served] = c;
+    device->completion[device->n_served] = device->now_us;
+    device->n_served++;
+}
@@ -0,0 +1,72 @@
+#ifndef DISK_SIM_H__
+#define DISK_SIM_H__
+
+#include <stddef.h>
+
+/*
+  Local stand-in for the device of tasks_lib.h with a timing model. Build the
+  schedulers with -DDISK_SIM to run them against it.
+
+  - seek: settle time plus a*sqrt(d) for short seeks (acceleration bound) and
+    a linear part beyond `seek_knee` cylinders (coast bound)
+  - rotation: the platters spin at `rpm`; the head waits until the sector of
+    the request passes under it
+  - transfer: `request_sectors` sectors at the media rate of the track; outer
+    cylinders hold more sectors per track than inner ones (zoned recording)
+
+  All times are in microseconds.
+*/
+struct disk_model {
+    int cylinders;
+    double rpm;
+    int spt_outer;        // sectors per track at cylinder 0
+    int spt_inner;        // sectors per track at the last cylinder
+    int request_sectors;
+    double settle_us;
+    double seek_sqrt_us;  // per sqrt(cylinder) up to the knee
+    double seek_linear_us;// per cylinder beyond the knee
+    int seek_knee;
+};
+
+struct device_t {
+    struct disk_model model;
+    int cylinder;
+    int direction;        // 1 = up, -1 = down
+    double now_us;
+    unsigned* visits;     // requests served per cylinder, picks the sector
+
+    double seek_us;       // time spent seeking
+    double rotation_us;   // time spent waiting for the sector
+    double transfer_us;
+
+    int* served;          // cylinder and completion time of every dev_work
+    double* completion;
+    size_t n_served;
+    size_t cap_served;
+};
+
+// Fills in a 7200 rpm drive with 10000 cylinders
+void disk_model_default(struct disk_model* m);
+
+// Seek time in microseconds for a distance in cylinders
+double disk_seek_time(const struct disk_model* m, int distance);
+
+// Returns 0 on success
+int dev_sim_init(struct device_t* device, const struct disk_model* m, int cylinder, int direction);
+void dev_sim_free(struct device_t* device);
+
+// Forgets the log of served requests
+void dev_sim_clear_log(struct device_t* device);
+
+// Lets the clock run forward while the disk is idle
+void dev_sim_idle_until(struct device_t* device, double t_us);
+
+// The device API of tasks_lib.h
+int dev_get_cylinder(struct device_t* device);
+int dev_get_max_cylinder(struct device_t* device);
+int dev_get_direction(struct device_t* device);
+void dev_move_to_cylinder(struct device_t* device, int cylinder);
+void dev_work(struct device_t* device);
+void dev_switch_direction(struct device_t* device);
+
+#endif // DISK_SIM_H__
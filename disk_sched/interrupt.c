@@ -1,11 +1,22 @@
+#include <stdatomic.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include <time.h>
+#include "../metrics/metrics.h"
+
+// coalescing polls the descriptor ring of the zero-copy mode
+#if defined(COALESCE) && !defined(ZERO_COPY)
+#define ZERO_COPY
+#endif
 
 #ifdef VPL
 // Don't touch these lines
 #include "interrupt.h"
 extern uint8_t** reg_buffer_device;
+#elif defined(INTERRUPT_SIM)
+// Load-test harness, see interrupt_sim.c
+#include "interrupt_sim.h"
 #else
 /*
   These definitions are here in case you want to develop locally.
@@ -57,37 +68,285 @@ void schedule_upper_half(uint8_t* buffer) {
 	schedule_upper_half_cleanup(buffer);
 }
 
+// Same for several buffers at once
+void schedule_upper_half_batch(uint8_t** buffers, int n) {
+	for(int i = 0; i < n; ++i)
+		schedule_upper_half_cleanup(buffers[i]);
+}
+
+// Masks (1) or unmasks (0) the interrupt line of the device. While masked
+// the device keeps filling buffers but raises no interrupt.
+_Atomic int device_irq_masked = 0;
+void mask_device_irq(int masked) {
+	atomic_store(&device_irq_masked, masked);
+}
+
 #endif
 
 // ----- Start implementing things here ----- //
 #ifndef SIZE
 #define SIZE 4096
 #endif
+#ifndef POOL_SIZE
 #define POOL_SIZE 8
+#endif
+
+// One bit per pool buffer, set while the buffer is in use. Acquire claims the
+// lowest clear bit with a CAS, release clears the bit of the buffer again, so
+// both are O(1) and safe between the ISR and upper-half threads.
+_Static_assert(POOL_SIZE <= 64, "pool bitmap holds at most 64 buffers");
+#define POOL_MASK (POOL_SIZE == 64 ? ~0ULL : (1ULL << POOL_SIZE) - 1)
 
-uint8_t buffer[SIZE];
-static uint8_t buffer_pool[POOL_SIZE][SIZE];
-static volatile uint8_t pool_in_use[POOL_SIZE] = {0};
+static _Alignas(64) uint8_t buffer_pool[POOL_SIZE][SIZE];
+static _Atomic uint64_t pool_in_use = 0;
 
 static uint8_t* acquire_buffer(void){
-    for(int i = 0; i < POOL_SIZE; ++i){
-        if(!pool_in_use[i]){
-            pool_in_use[i] = 1;
+    uint64_t used = atomic_load_explicit(&pool_in_use, memory_order_relaxed);
+    for(;;){
+        uint64_t free_bits = ~used & POOL_MASK;
+        if(!free_bits)
+            return NULL;
+        int i = __builtin_ctzll(free_bits);
+        if(atomic_compare_exchange_weak_explicit(&pool_in_use, &used, used | (1ULL << i),
+                                                 memory_order_acquire, memory_order_relaxed))
             return buffer_pool[i];
-        }
     }
-    return NULL;
 }
 
+#ifndef ZERO_COPY
 static void release_buffer(uint8_t* buf){
-    for(int i = 0; i < POOL_SIZE; ++i){
-        if(buf == buffer_pool[i]){
-            pool_in_use[i] = 0;
+    uintptr_t off = (uintptr_t)buf - (uintptr_t)buffer_pool;
+    size_t i = off / SIZE;
+    if(i >= POOL_SIZE || off % SIZE)
+        return;
+    atomic_fetch_and_explicit(&pool_in_use, ~(1ULL << i), memory_order_release);
+}
+#endif
+
+#ifdef ZERO_COPY
+/*
+  Zero-copy receive: the driver pre-posts pool buffers into a ring of
+  descriptors and the device DMA-writes straight into them. Ownership of a
+  descriptor moves DESC_DEVICE (posted, device may write) -> DESC_DRIVER
+  (filled, ISR may take it) -> DESC_EMPTY (buffer is with the upper half).
+  The upper-half cleanup posts the buffer again. Since there are as many
+  descriptors as pool buffers, a post never finds its slot still in use.
+*/
+#define RING_SIZE POOL_SIZE
+_Static_assert((RING_SIZE & (RING_SIZE - 1)) == 0, "ring size must be a power of two");
+
+enum desc_owner { DESC_EMPTY, DESC_DEVICE, DESC_DRIVER };
+
+struct rx_desc {
+    uint8_t* buf;
+    size_t len;              // bytes written by the device
+    _Atomic int owner;
+};
+
+static struct rx_desc rx_ring[RING_SIZE];
+static size_t rx_next = 0;              // next descriptor to reap
+static _Atomic size_t rx_post = 0;      // next descriptor to post to
+
+static void post_buffer(uint8_t* buf){
+    size_t i = atomic_fetch_add_explicit(&rx_post, 1, memory_order_relaxed) % RING_SIZE;
+    rx_ring[i].buf = buf;
+    rx_ring[i].len = 0;
+    atomic_store_explicit(&rx_ring[i].owner, DESC_DEVICE, memory_order_release);
+}
+
+// Posts every pool buffer to the device; call once before interrupts start
+int rx_ring_init(void){
+    for(int i = 0; i < RING_SIZE; ++i){
+        uint8_t* buf = acquire_buffer();
+        if(buf == NULL)
+            return -1;
+        post_buffer(buf);
+    }
+    return 0;
+}
+
+// Takes up to `max` filled descriptors out of the ring. Only one context
+// reaps at a time; with COALESCE that is whoever owns the ring (rx_polling).
+static int rx_reap(uint8_t* out[], int max){
+    int n = 0;
+    while(n < max){
+        struct rx_desc* d = &rx_ring[rx_next % RING_SIZE];
+        if(atomic_load_explicit(&d->owner, memory_order_acquire) != DESC_DRIVER)
             break;
+        out[n++] = d->buf;
+        atomic_store_explicit(&d->owner, DESC_EMPTY, memory_order_relaxed);
+        ++rx_next;
+    }
+    return n;
+}
+
+#ifdef COALESCE
+/*
+  NAPI-style coalescing. While the interrupt rate stays below COALESCE_RATE
+  the ISR reaps the ring itself. Above it the ISR masks the device interrupt
+  and leaves the ring to rx_poll(), which hands buffers to the upper half in
+  batches of up to COALESCE_MAX_BATCH, or earlier once the oldest buffer has
+  waited COALESCE_MAX_USECS. When a poll finds the ring empty, interrupts are
+  unmasked again.
+
+  rx_polling says who owns the ring (rx_next and the descriptors). The ISR
+  takes it from RX_IDLE with a CAS before reaping, the poller holds it from
+  the switch to polling until it hands it back with a CAS, so the two never
+  reap at once. An interrupt that finds the poller owning the ring marks it
+  RX_POLL_KICKED, and the hand-back fails: the poller cannot know whether
+  it saw that buffer, so it keeps polling.
+*/
+#ifndef COALESCE_RATE
+#define COALESCE_RATE 20000         // interrupts per second
+#endif
+#ifndef COALESCE_MAX_BATCH
+#define COALESCE_MAX_BATCH (POOL_SIZE / 2)
+#endif
+#ifndef COALESCE_MAX_USECS
+#define COALESCE_MAX_USECS 50
+#endif
+#define COALESCE_WINDOW_NS 1000000  // rate is measured over 1 ms windows
+
+struct coalesce_stats {
+    atomic_ulong interrupts;
+    atomic_ulong saved;             // buffers reaped by polling instead of an interrupt
+    atomic_ulong batches;
+    atomic_ulong buffers;
+    atomic_ulong polls;
+};
+static struct coalesce_stats cstats;
+
+enum rx_owner { RX_IDLE, RX_ISR, RX_POLL, RX_POLL_KICKED };
+
+static _Atomic int rx_polling = RX_IDLE;
+static uint64_t window_start, window_count;     // ISR only
+
+// Partial batch, owned by the poller
+static uint8_t* batch[COALESCE_MAX_BATCH];
+static int batch_n = 0;
+static uint64_t batch_oldest;
+
+static uint64_t now_ns(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+int rx_polling_active(void){
+    return atomic_load_explicit(&rx_polling, memory_order_acquire) >= RX_POLL;
+}
+
+static void flush_batch(void){
+    if(!batch_n)
+        return;
+    atomic_fetch_add_explicit(&cstats.batches, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&cstats.buffers, (unsigned long)batch_n, memory_order_relaxed);
+    METRIC_RECORD(HIST_IRQ_BATCH, batch_n);
+    schedule_upper_half_batch(batch, batch_n);
+    batch_n = 0;
+}
+
+int ISR() {
+    atomic_fetch_add_explicit(&cstats.interrupts, 1, memory_order_relaxed);
+    METRIC_INC(CNT_IRQS);
+    uint64_t now = now_ns();
+    if(now - window_start > COALESCE_WINDOW_NS){
+        window_start = now;
+        window_count = 0;
+    }
+    int owner = RX_IDLE;
+    if(!atomic_compare_exchange_strong_explicit(&rx_polling, &owner, RX_ISR,
+                                                memory_order_acquire, memory_order_relaxed)){
+        // the poller owns the ring; make it look again before handing it back
+        if(owner == RX_POLL)
+            atomic_compare_exchange_strong_explicit(&rx_polling, &owner, RX_POLL_KICKED,
+                                                    memory_order_relaxed, memory_order_relaxed);
+    }else if(++window_count > (uint64_t)COALESCE_RATE * COALESCE_WINDOW_NS / 1000000000ull){
+        mask_device_irq(1);
+        window_count = 0;
+        atomic_store_explicit(&rx_polling, RX_POLL, memory_order_release);
+    }else{
+        uint8_t* bufs[RING_SIZE];
+        int reaped = rx_reap(bufs, RING_SIZE);
+        atomic_store_explicit(&rx_polling, RX_IDLE, memory_order_release);
+        if(reaped){
+            atomic_fetch_add_explicit(&cstats.batches, 1, memory_order_relaxed);
+            atomic_fetch_add_explicit(&cstats.buffers, (unsigned long)reaped, memory_order_relaxed);
+            METRIC_RECORD(HIST_IRQ_BATCH, reaped);
+            schedule_upper_half_batch(bufs, reaped);
         }
     }
+
+    disable_interrupts();
+    ack_buffer_copied();
+    enable_interrupts();
+    METRIC_ELAPSED(HIST_ISR_NS, now);
+    return 0;
+}
+
+// One round of polling; returns the number of buffers reaped
+int rx_poll(void){
+    if(!rx_polling_active())
+        return 0;
+    atomic_fetch_add_explicit(&cstats.polls, 1, memory_order_relaxed);
+
+    int got = rx_reap(batch + batch_n, COALESCE_MAX_BATCH - batch_n);
+    if(got && !batch_n)
+        batch_oldest = now_ns();
+    batch_n += got;
+    atomic_fetch_add_explicit(&cstats.saved, (unsigned long)got, memory_order_relaxed);
+
+    if(batch_n == COALESCE_MAX_BATCH || (batch_n && now_ns() - batch_oldest >= COALESCE_MAX_USECS * 1000ull))
+        flush_batch();
+
+    if(!got){
+        // ring drained: back to interrupts. A buffer that arrived before the
+        // unmask raised no interrupt, so look once more while still owning
+        // the ring; one that arrives after it kicks the hand-back.
+        flush_batch();
+        mask_device_irq(0);
+        int owner = RX_POLL;
+        if(atomic_load_explicit(&rx_ring[rx_next % RING_SIZE].owner, memory_order_acquire) == DESC_DRIVER
+           || !atomic_compare_exchange_strong_explicit(&rx_polling, &owner, RX_IDLE,
+                                                       memory_order_release, memory_order_relaxed)){
+            mask_device_irq(1);
+            atomic_store_explicit(&rx_polling, RX_POLL, memory_order_relaxed);
+        }
+    }
+    return got;
+}
+
+void coalesce_report(FILE* out){
+    unsigned long irqs = atomic_load(&cstats.interrupts);
+    unsigned long batches = atomic_load(&cstats.batches);
+    unsigned long buffers = atomic_load(&cstats.buffers);
+    fprintf(out, "interrupts %lu, saved %lu, polls %lu, batches %lu, buffers %lu (%.1f per batch)\n",
+            irqs, atomic_load(&cstats.saved), atomic_load(&cstats.polls), batches, buffers,
+            batches ? (double)buffers / (double)batches : 0.0);
+}
+#else
+// Hands every filled descriptor to the upper half without copying
+int ISR() {
+    METRIC_TIMER(t0);
+    METRIC_INC(CNT_IRQS);
+    uint8_t* bufs[RING_SIZE];
+    int reaped = rx_reap(bufs, RING_SIZE);
+    if(reaped)
+        METRIC_RECORD(HIST_IRQ_BATCH, reaped);
+    for(int i = 0; i < reaped; ++i)
+        schedule_upper_half(bufs[i]);
+
+    disable_interrupts();
+    ack_buffer_copied();
+    enable_interrupts();
+    METRIC_ELAPSED(HIST_ISR_NS, t0);
+    return reaped ? 0 : -1;
 }
+#endif
+#else
 int ISR() {
+    METRIC_TIMER(t0);
+    METRIC_INC(CNT_IRQS);
     disable_interrupts();
 	uint8_t *dev_buffer = *reg_buffer_device;
 	ack_reg_copied();
@@ -95,36 +354,82 @@ int ISR() {
     
     uint8_t *local_buf = acquire_buffer();
     if(local_buf == NULL){
+        METRIC_INC(CNT_IRQ_POOL_EXHAUSTED);
         return -1;
     }
     
-	copy_dev_buffer(dev_buffer, buffer, SIZE);
+	copy_dev_buffer(dev_buffer, local_buf, SIZE);
+    METRIC_ADD(CNT_IRQ_BYTES_COPIED, SIZE);
 
     disable_interrupts();
 	ack_buffer_copied();
 	enable_interrupts();
 
-	schedule_upper_half(buffer);
+	schedule_upper_half(local_buf);
+    METRIC_ELAPSED(HIST_ISR_NS, t0);
 	return 0;
 }
 
+#endif
+
 // Cleans up the buffer used in schedule_upper_half (e.g. deallocate, etc.)
 // Do NOT call this function yourself. Assume it is called automatically in
 // schedule_upper_half.
 void schedule_upper_half_cleanup(void* ptr) {
 	if(ptr != NULL){
+#ifdef ZERO_COPY
+	    post_buffer((uint8_t*)ptr);
+#else
 	    release_buffer((uint8_t*)ptr);
+#endif
 	}
 }
 
 // For testing, you can get a device buffer like this:
 // Remember to NOT include a main() function in your submission
 // (Inside ifndef VPL, it's ok)
-#ifndef VPL
+#if !defined(VPL) && defined(ZERO_COPY)
+// Device side of the ring: DMA-writes into the next posted descriptor.
+// Returns -1 if the driver has not posted a buffer yet (data is dropped).
+int dev_dma_receive(const uint8_t* data, size_t len){
+	static size_t dev_next = 0;
+	struct rx_desc* d = &rx_ring[dev_next % RING_SIZE];
+	if(atomic_load_explicit(&d->owner, memory_order_acquire) != DESC_DEVICE)
+		return -1;
+	memcpy(d->buf, data, len);
+	d->len = len;
+	atomic_store_explicit(&d->owner, DESC_DRIVER, memory_order_release);
+	++dev_next;
+	return 0;
+}
+#endif
+
+#if !defined(VPL) && !defined(INTERRUPT_SIM)
 int main() {
 	uint8_t dev_buf[SIZE] = {0xab};
+#if defined(COALESCE)
+	// a burst of 1000 buffers, far above the coalescing rate
+	rx_ring_init();
+	for(int i = 0; i < 1000; ){
+		if(dev_dma_receive(dev_buf, SIZE) == 0){
+			++i;
+			if(!atomic_load(&device_irq_masked))
+				ISR();
+		}
+		rx_poll();
+	}
+	while(rx_polling_active())
+		rx_poll();
+	coalesce_report(stdout);
+#elif defined(ZERO_COPY)
+	rx_ring_init();
+	dev_dma_receive(dev_buf, SIZE);
+	dev_dma_receive(dev_buf, SIZE);
+	ISR();
+#else
 	uint8_t* dev_buf_ptr = (uint8_t*)dev_buf;
 	reg_buffer_device = &dev_buf_ptr;
 	ISR();
+#endif
 }
 #endif
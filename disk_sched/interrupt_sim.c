@@ -0,0 +1,285 @@
+#define _GNU_SOURCE
+#include <getopt.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "interrupt_sim.h"
+
+static uint64_t now_ns(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void atomic_max(atomic_ullong* a, unsigned long long v){
+    unsigned long long cur = atomic_load_explicit(a, memory_order_relaxed);
+    while(v > cur && !atomic_compare_exchange_weak_explicit(a, &cur, v, memory_order_relaxed,
+                                                            memory_order_relaxed))
+        ;
+}
+
+// ----- device and kernel side ----- //
+
+uint8_t** reg_buffer_device;
+static uint8_t dev_buf[SIZE];
+static uint8_t* dev_buf_ptr = dev_buf;
+
+static _Thread_local uint64_t disabled_at;
+static atomic_ullong disabled_total_ns;
+static atomic_ullong disabled_max_ns;
+static atomic_ullong bytes_copied;
+
+void disable_interrupts(){
+    disabled_at = now_ns();
+}
+
+void enable_interrupts(){
+    uint64_t d = now_ns() - disabled_at;
+    atomic_fetch_add_explicit(&disabled_total_ns, d, memory_order_relaxed);
+    atomic_max(&disabled_max_ns, d);
+}
+
+void ack_reg_copied(){}
+void ack_buffer_copied(){}
+
+void copy_dev_buffer(uint8_t* src, uint8_t* dest, size_t size){
+    memcpy(dest, src, size);
+    atomic_fetch_add_explicit(&bytes_copied, size, memory_order_relaxed);
+}
+
+_Atomic int device_irq_masked = 0;
+void mask_device_irq(int masked){
+    atomic_store(&device_irq_masked, masked);
+}
+
+// ----- upper halves on worker threads ----- //
+
+// At most the pool of interrupt.c is ever queued
+#define WORK_QUEUE_SIZE 65536
+
+static struct {
+    uint8_t* items[WORK_QUEUE_SIZE];
+    size_t head, n;
+    int closed;
+    pthread_mutex_t lock;
+    pthread_cond_t nonempty;
+} work = { .lock = PTHREAD_MUTEX_INITIALIZER, .nonempty = PTHREAD_COND_INITIALIZER };
+
+static unsigned work_us;            // busy time per upper half
+static uint64_t* latency;           // end-to-end, per completed buffer
+static atomic_size_t n_latency;
+static atomic_ullong checksum;
+
+static void work_push_locked(uint8_t* buffer){
+    if(work.n == WORK_QUEUE_SIZE){
+        fprintf(stderr, "work queue overflow\n");
+        abort();
+    }
+    work.items[(work.head + work.n++) % WORK_QUEUE_SIZE] = buffer;
+}
+
+void schedule_upper_half(uint8_t* buffer){
+    pthread_mutex_lock(&work.lock);
+    work_push_locked(buffer);
+    pthread_cond_signal(&work.nonempty);
+    pthread_mutex_unlock(&work.lock);
+}
+
+void schedule_upper_half_batch(uint8_t** buffers, int n){
+    pthread_mutex_lock(&work.lock);
+    for(int i = 0; i < n; ++i)
+        work_push_locked(buffers[i]);
+    pthread_cond_broadcast(&work.nonempty);
+    pthread_mutex_unlock(&work.lock);
+}
+
+static void* upper_half_worker(void* arg){
+    (void)arg;
+    for(;;){
+        pthread_mutex_lock(&work.lock);
+        while(!work.n && !work.closed)
+            pthread_cond_wait(&work.nonempty, &work.lock);
+        if(!work.n){
+            pthread_mutex_unlock(&work.lock);
+            return NULL;
+        }
+        uint8_t* buffer = work.items[work.head];
+        work.head = (work.head + 1) % WORK_QUEUE_SIZE;
+        work.n--;
+        pthread_mutex_unlock(&work.lock);
+
+        uint64_t raised;
+        memcpy(&raised, buffer, sizeof(raised));
+        uint64_t until = now_ns() + work_us * 1000ull;
+        unsigned long long sum = 0;
+        for(size_t i = sizeof(raised); i < SIZE; i += 64)
+            sum += buffer[i];
+        while(now_ns() < until)
+            ;
+        schedule_upper_half_cleanup(buffer);
+
+        atomic_fetch_add_explicit(&checksum, sum, memory_order_relaxed);
+        latency[atomic_fetch_add(&n_latency, 1)] = now_ns() - raised;
+    }
+}
+
+// ----- interrupt source ----- //
+
+static uint64_t* isr_ns;
+static size_t n_isr;
+static unsigned long exhausted;     // buffers lost because the pool was empty
+
+static void raise_interrupt(void){
+    uint64_t t = now_ns();
+    memcpy(dev_buf, &t, sizeof(t));
+#ifdef ZERO_COPY
+    if(dev_dma_receive(dev_buf, SIZE) == -1){
+        ++exhausted;
+        return;
+    }
+    if(atomic_load(&device_irq_masked))
+        return;
+#endif
+    uint64_t start = now_ns();
+    int ret = ISR();
+    isr_ns[n_isr++] = now_ns() - start;
+#ifndef ZERO_COPY
+    if(ret == -1)
+        ++exhausted;
+#else
+    (void)ret;
+#endif
+}
+
+static void sleep_until(uint64_t t){
+    struct timespec ts = { (time_t)(t / 1000000000ull), (long)(t % 1000000000ull) };
+    while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL))
+        ;
+}
+
+static int cmp_u64(const void* a, const void* b){
+    uint64_t x = *(const uint64_t*)a;
+    uint64_t y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+
+static uint64_t percentile(const uint64_t* v, size_t n, double p){
+    if(!n) return 0;
+    size_t rank = (size_t)(p / 100.0 * (double)n);
+    return v[rank < n ? rank : n - 1];
+}
+
+static void usage(const char* prog){
+    fprintf(stderr,
+            "usage: %s [-r rate] [-b burst] [-n interrupts] [-w workers] [-u work_us]\n"
+            "  -r  interrupts per second (default 100000)\n"
+            "  -b  interrupts raised back to back per timer tick (default 1)\n"
+            "  -n  total interrupts (default 100000)\n"
+            "  -w  upper-half worker threads (default 2)\n"
+            "  -u  busy time of one upper half in microseconds (default 0)\n", prog);
+}
+
+int main(int argc, char** argv){
+    double rate = 100000;
+    unsigned burst = 1, workers = 2;
+    size_t count = 100000;
+    int opt;
+    while((opt = getopt(argc, argv, "r:b:n:w:u:h")) != -1){
+        switch(opt){
+        case 'r': rate = atof(optarg); break;
+        case 'b': burst = (unsigned)atoi(optarg); break;
+        case 'n': count = (size_t)atoll(optarg); break;
+        case 'w': workers = (unsigned)atoi(optarg); break;
+        case 'u': work_us = (unsigned)atoi(optarg); break;
+        default: usage(argv[0]); return opt == 'h' ? 0 : 1;
+        }
+    }
+    if(rate <= 0 || !burst || !workers || !count){
+        usage(argv[0]);
+        return 1;
+    }
+
+    reg_buffer_device = &dev_buf_ptr;
+    isr_ns = malloc(count * sizeof(*isr_ns));
+    latency = malloc(count * sizeof(*latency));
+    pthread_t* threads = malloc(workers * sizeof(*threads));
+    if(!isr_ns || !latency || !threads){
+        perror("malloc");
+        return 1;
+    }
+#ifdef ZERO_COPY
+    if(rx_ring_init() == -1){
+        fprintf(stderr, "could not post the receive ring\n");
+        return 1;
+    }
+#endif
+    for(unsigned i = 0; i < workers; ++i)
+        pthread_create(&threads[i], NULL, upper_half_worker, NULL);
+
+    uint64_t period = (uint64_t)(burst * 1e9 / rate);
+    uint64_t start = now_ns(), next = start;
+    for(size_t raised = 0; raised < count; ){
+        for(unsigned b = 0; b < burst && raised < count; ++b, ++raised)
+            raise_interrupt();
+        next += period;
+#ifdef COALESCE
+        // the timer thread doubles as the poller: at least one round per
+        // tick, more while there is time left until the next one
+        if(rx_polling_active()){
+            do rx_poll();
+            while(rx_polling_active() && now_ns() < next);
+        }
+#endif
+        sleep_until(next);
+    }
+#ifdef COALESCE
+    while(rx_polling_active())
+        rx_poll();
+#endif
+
+    pthread_mutex_lock(&work.lock);
+    work.closed = 1;
+    pthread_cond_broadcast(&work.nonempty);
+    pthread_mutex_unlock(&work.lock);
+    for(unsigned i = 0; i < workers; ++i)
+        pthread_join(threads[i], NULL);
+    double wall = (double)(now_ns() - start) / 1e9;
+
+    size_t n_lat = atomic_load(&n_latency);
+    qsort(isr_ns, n_isr, sizeof(*isr_ns), cmp_u64);
+    qsort(latency, n_lat, sizeof(*latency), cmp_u64);
+    uint64_t isr_total = 0;
+    for(size_t i = 0; i < n_isr; ++i)
+        isr_total += isr_ns[i];
+
+    printf("raised %zu interrupts in %.3f s (%.0f/s), %zu ISR calls\n",
+           count, wall, (double)count / wall, n_isr);
+    printf("pool exhausted: %lu buffers dropped (%.2f%%)\n",
+           exhausted, 100.0 * (double)exhausted / (double)count);
+    printf("ISR ns: avg %.0f  p50 %llu  p99 %llu  max %llu\n",
+           n_isr ? (double)isr_total / (double)n_isr : 0.0,
+           (unsigned long long)percentile(isr_ns, n_isr, 50),
+           (unsigned long long)percentile(isr_ns, n_isr, 99),
+           (unsigned long long)percentile(isr_ns, n_isr, 100));
+    printf("interrupts disabled: %.3f ms total (%.3f%% of wall time), longest %llu ns\n",
+           (double)atomic_load(&disabled_total_ns) / 1e6,
+           100.0 * (double)atomic_load(&disabled_total_ns) / 1e9 / wall,
+           atomic_load(&disabled_max_ns));
+    printf("end-to-end latency us over %zu buffers: p50 %.1f  p90 %.1f  p99 %.1f  p99.9 %.1f  max %.1f\n",
+           n_lat, (double)percentile(latency, n_lat, 50) / 1e3,
+           (double)percentile(latency, n_lat, 90) / 1e3,
+           (double)percentile(latency, n_lat, 99) / 1e3,
+           (double)percentile(latency, n_lat, 99.9) / 1e3,
+           (double)percentile(latency, n_lat, 100) / 1e3);
+    printf("bytes copied: %llu\n", atomic_load(&bytes_copied));
+#ifdef COALESCE
+    coalesce_report(stdout);
+#endif
+
+    free(threads);
+    free(isr_ns);
+    free(latency);
+    return 0;
+}
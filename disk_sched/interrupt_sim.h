@@ -0,0 +1,55 @@
+#ifndef INTERRUPT_SIM_H__
+#define INTERRUPT_SIM_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+  Device and kernel side for interrupt.c when it is built with
+  -DINTERRUPT_SIM (replaces the stand-ins of the local build):
+
+    gcc -DINTERRUPT_SIM interrupt.c interrupt_sim.c -lpthread
+    gcc -DINTERRUPT_SIM -DZERO_COPY interrupt.c interrupt_sim.c -lpthread
+    gcc -DINTERRUPT_SIM -DCOALESCE interrupt.c interrupt_sim.c -lpthread
+
+  A timer thread raises interrupts and calls ISR(), upper halves run on a
+  pool of worker threads. The device writes the time it raised the
+  interrupt into the first bytes of every buffer, which gives the
+  end-to-end latency when the upper half is done with it.
+*/
+
+#define SIZE 4096
+
+// same as in interrupt.c: coalescing polls the zero-copy ring
+#if defined(COALESCE) && !defined(ZERO_COPY)
+#define ZERO_COPY
+#endif
+
+extern uint8_t** reg_buffer_device;
+
+void enable_interrupts();
+void disable_interrupts();
+void ack_reg_copied();
+void ack_buffer_copied();
+void copy_dev_buffer(uint8_t* src, uint8_t* dest, size_t size);
+void schedule_upper_half(uint8_t* buffer);
+void schedule_upper_half_batch(uint8_t** buffers, int n);
+void schedule_upper_half_cleanup(void* ptr);
+
+extern _Atomic int device_irq_masked;
+void mask_device_irq(int masked);
+
+// Provided by interrupt.c
+int ISR();
+#ifdef ZERO_COPY
+int rx_ring_init(void);
+int dev_dma_receive(const uint8_t* data, size_t len);
+#endif
+#ifdef COALESCE
+int rx_poll(void);
+int rx_polling_active(void);
+void coalesce_report(FILE* out);
+#endif
+
+#endif // INTERRUPT_SIM_H__
@@ -0,0 +1,411 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+/* file_ops.h declares our tee(), which clashes with the one _GNU_SOURCE
+ * makes visible in fcntl.h */
+#define tee file_ops_tee
+#include "file_ops.h"
+#undef tee
+
+/*
+ * Benchmark suite for the tee and reverse strategies:
+ *
+ *     gcc -O2 bench.c tasks.c tee_uring.c reverse_mmap.c reverse_simd.c io_pipeline.c \
+ *         reverse_stream.c reverse_direct.c -o bench -lpthread \
+ *         -Wl,--wrap=read,--wrap=write,--wrap=pread,--wrap=pwrite,--wrap=lseek \
+ *         -Wl,--wrap=mmap,--wrap=munmap,--wrap=madvise,--wrap=ftruncate,--wrap=fcntl \
+ *         -Wl,--wrap=syscall
+ *     ./bench -s 1024 -c both
+ *
+ * Every run is a forked child, so its peak RSS comes from wait4() and the
+ * runs do not share heap state. The --wrap'ed calls above are counted in
+ * shared memory and reported per MB moved (io_uring and splice go through
+ * syscall() and are counted there).
+ *
+ * Cache modes: "hot" reads an input already in the page cache, "cold"
+ * writes the input with O_DIRECT (or fadvise DONTNEED where O_DIRECT is not
+ * supported) and drops it from the cache again before each run.
+ */
+
+#define FEED_CHUNK (1 << 20)
+
+/* ----- syscall counting ----- */
+
+struct counters {
+    atomic_ulong calls;
+};
+static struct counters *counters;   /* shared with the children */
+static int counting;                /* set in the measured child only */
+
+static void count(void) {
+    if (counting)
+        atomic_fetch_add_explicit(&counters->calls, 1, memory_order_relaxed);
+}
+
+ssize_t __real_read(int fd, void *buf, size_t n);
+ssize_t __wrap_read(int fd, void *buf, size_t n) { count(); return __real_read(fd, buf, n); }
+ssize_t __real_write(int fd, const void *buf, size_t n);
+ssize_t __wrap_write(int fd, const void *buf, size_t n) { count(); return __real_write(fd, buf, n); }
+ssize_t __real_pread(int fd, void *buf, size_t n, off_t off);
+ssize_t __wrap_pread(int fd, void *buf, size_t n, off_t off) { count(); return __real_pread(fd, buf, n, off); }
+ssize_t __real_pwrite(int fd, const void *buf, size_t n, off_t off);
+ssize_t __wrap_pwrite(int fd, const void *buf, size_t n, off_t off) { count(); return __real_pwrite(fd, buf, n, off); }
+off_t __real_lseek(int fd, off_t off, int whence);
+off_t __wrap_lseek(int fd, off_t off, int whence) { count(); return __real_lseek(fd, off, whence); }
+void *__real_mmap(void *addr, size_t len, int prot, int flags, int fd, off_t off);
+void *__wrap_mmap(void *addr, size_t len, int prot, int flags, int fd, off_t off) {
+    count();
+    return __real_mmap(addr, len, prot, flags, fd, off);
+}
+int __real_munmap(void *addr, size_t len);
+int __wrap_munmap(void *addr, size_t len) { count(); return __real_munmap(addr, len); }
+int __real_madvise(void *addr, size_t len, int advice);
+int __wrap_madvise(void *addr, size_t len, int advice) { count(); return __real_madvise(addr, len, advice); }
+int __real_ftruncate(int fd, off_t len);
+int __wrap_ftruncate(int fd, off_t len) { count(); return __real_ftruncate(fd, len); }
+int __real_fcntl(int fd, int cmd, ...);
+int __wrap_fcntl(int fd, int cmd, ...) {
+    va_list ap;
+    va_start(ap, cmd);
+    long arg = va_arg(ap, long);    /* every command we use takes an int or nothing */
+    va_end(ap);
+    count();
+    return __real_fcntl(fd, cmd, arg);
+}
+long __real_syscall(long nr, ...);
+long __wrap_syscall(long nr, ...) {
+    va_list ap;
+    long a[6];
+    va_start(ap, nr);
+    for (int i = 0; i < 6; ++i)
+        a[i] = va_arg(ap, long);
+    va_end(ap);
+    count();
+    return __real_syscall(nr, a[0], a[1], a[2], a[3], a[4], a[5]);
+}
+
+/* ----- helpers ----- */
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void drop_cache(const char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd == -1)
+        return;
+    fdatasync(fd);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+}
+
+/* Writes size bytes of text-like data; with direct, bypassing the cache */
+static int generate(const char *path, long long size, int direct) {
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | (direct ? O_DIRECT : 0), 0644);
+    if (fd == -1 && direct)
+        fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);   /* e.g. tmpfs */
+    if (fd == -1)
+        return -1;
+    char *chunk;
+    if (posix_memalign((void **)&chunk, 4096, FEED_CHUNK)) {
+        close(fd);
+        return -1;
+    }
+    for (size_t i = 0; i < FEED_CHUNK; ++i)
+        chunk[i] = i % 64 == 63 ? '\n' : (char)('a' + i % 26);
+
+    int ret = 0;
+    long long left = size;
+    while (left > 0 && ret == 0) {
+        size_t n = left < FEED_CHUNK ? (size_t)left : FEED_CHUNK;
+        if (n % 4096 && (fcntl(fd, F_GETFL) & O_DIRECT))
+            fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_DIRECT);   /* unaligned tail */
+        ret = file_ops_full_write(fd, chunk, n);
+        left -= (long long)n;
+    }
+    free(chunk);
+    if (close(fd) == -1)
+        ret = -1;
+    if (ret == 0 && direct)
+        drop_cache(path);
+    return ret;
+}
+
+struct result {
+    double seconds;
+    unsigned long syscalls;
+    long max_rss_kb;
+};
+
+/* Runs fn(arg) in a child with counting on; returns -1 if it failed */
+static int measure(int (*fn)(void *), void *arg, size_t buffer_size, struct result *res,
+                   void (*parent_side)(void *), void *parent_arg) {
+    atomic_store(&counters->calls, 0);
+    double start = now_sec();
+    pid_t pid = fork();
+    if (pid == -1)
+        return -1;
+    if (pid == 0) {
+        file_ops_set_buffer_size(buffer_size);
+        counting = 1;
+        int ret = fn(arg);
+        counting = 0;
+        _exit(ret == 0 ? 0 : 1);
+    }
+    if (parent_side)
+        parent_side(parent_arg);
+    int status;
+    struct rusage ru;
+    if (wait4(pid, &status, 0, &ru) == -1)
+        return -1;
+    res->seconds = now_sec() - start;
+    res->syscalls = atomic_load(&counters->calls);
+    res->max_rss_kb = ru.ru_maxrss;
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0 ? 0 : -1;
+}
+
+/* ----- tee ----- */
+
+struct tee_run {
+    enum tee_strategy strategy;
+    const char *input, *output;
+    int in_pipe[2], out_pipe[2];
+    long long got;
+};
+
+/* Feeds the input file into the stdin pipe of the tee child */
+static void feed(const char *path, int fd) {
+    static char buf[FEED_CHUNK];
+    int in = open(path, O_RDONLY);
+    ssize_t r;
+    while (in != -1 && (r = read(in, buf, sizeof(buf))) > 0)
+        if (file_ops_full_write(fd, buf, (size_t)r) == -1)
+            break;
+    _exit(0);
+}
+
+static int tee_child(void *arg) {
+    struct tee_run *t = arg;
+    dup2(t->in_pipe[0], STDIN_FILENO);
+    dup2(t->out_pipe[1], STDOUT_FILENO);
+    close(t->in_pipe[0]); close(t->in_pipe[1]);
+    close(t->out_pipe[0]); close(t->out_pipe[1]);
+    return tee_with(t->output, t->strategy);
+}
+
+static void tee_parent(void *arg) {
+    struct tee_run *t = arg;
+    close(t->in_pipe[0]);
+    close(t->out_pipe[1]);
+    pid_t feeder = fork();
+    if (feeder == 0) {
+        close(t->out_pipe[0]);
+        feed(t->input, t->in_pipe[1]);
+    }
+    close(t->in_pipe[1]);
+
+    static char sink[FEED_CHUNK];
+    ssize_t r;
+    t->got = 0;
+    while ((r = read(t->out_pipe[0], sink, sizeof(sink))) > 0)
+        t->got += r;
+    close(t->out_pipe[0]);
+    waitpid(feeder, NULL, 0);
+}
+
+static int run_tee(enum tee_strategy strategy, const char *input, const char *output,
+                   long long size, size_t buffer_size, struct result *res) {
+    struct tee_run t = { strategy, input, output, { -1, -1 }, { -1, -1 }, 0 };
+    if (pipe(t.in_pipe) == -1 || pipe(t.out_pipe) == -1)
+        return -1;
+    if (measure(tee_child, &t, buffer_size, res, tee_parent, &t) == -1 || t.got != size)
+        return -1;
+    struct stat st;
+    return stat(output, &st) == 0 && st.st_size == size ? 0 : -1;
+}
+
+/* ----- reverse ----- */
+
+struct reverse_run {
+    int strategy;   /* -1: reverse_file, -2: reverse_file_records by lines */
+    const char *input, *output;
+};
+
+static int reverse_child(void *arg) {
+    struct reverse_run *r = arg;
+    if (r->strategy == -1)
+        return reverse_file(r->input, r->output);
+    if (r->strategy == -2)
+        return reverse_file_records(r->input, r->output, 0);
+    return reverse_file_with(r->input, r->output, (enum reverse_strategy)r->strategy);
+}
+
+static int run_reverse(int strategy, const char *input, const char *output, long long size,
+                       size_t buffer_size, struct result *res) {
+    struct reverse_run r = { strategy, input, output };
+    if (measure(reverse_child, &r, buffer_size, res, NULL, NULL) == -1)
+        return -1;
+    struct stat st;
+    return stat(output, &st) == 0 && st.st_size == size ? 0 : -1;
+}
+
+/* ----- driver ----- */
+
+static const struct { const char *name; enum tee_strategy strategy; } tee_strategies[] = {
+    { "buffered", TEE_BUFFERED },
+    { "splice",   TEE_SPLICE },
+    { "io_uring", TEE_URING },
+    { "pipeline", TEE_PIPELINE },
+};
+
+static const struct { const char *name; int strategy; int sized; } reverse_strategies[] = {
+    { "naive",    -1,               1 },
+    { "chunked",  REVERSE_CHUNKED,  1 },
+    { "mmap",     REVERSE_MMAP,     0 },    /* window size is fixed */
+    { "pipeline", REVERSE_PIPELINE, 1 },
+    { "stream",   REVERSE_STREAM,   1 },
+    { "direct",   REVERSE_DIRECT,   1 },
+    { "lines",    -2,               1 },
+};
+
+static void report(const char *task, const char *name, size_t buffer_size, long long size,
+                   const struct result *best) {
+    char buf[32];
+    if (buffer_size)
+        snprintf(buf, sizeof(buf), "%zu", buffer_size >= 1024 ? buffer_size / 1024 : buffer_size);
+    printf("%-8s %-9s %8s%s %9.1f %12.1f %10ld\n", task, name,
+           buffer_size ? buf : "-", buffer_size >= 1024 ? "K" : buffer_size ? "B" : " ",
+           (double)size / 1e6 / best->seconds,
+           (double)best->syscalls / ((double)size / 1e6), best->max_rss_kb);
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "usage: %s [-s MiB] [-r runs] [-d dir] [-c hot|cold|both] [-t tee|reverse|all]\n"
+            "          [-b size,size,...]\n"
+            "  -s  input size in MiB (default 256)\n"
+            "  -r  runs per configuration, the best one is reported (default 3)\n"
+            "  -d  directory for the input and output files (default .)\n"
+            "  -c  page-cache state of the input (default hot)\n"
+            "  -b  buffer sizes to sweep, suffixes K and M (default 4K,16K,64K,256K,1M,4M)\n",
+            prog);
+}
+
+static size_t parse_size(const char *s) {
+    char *end;
+    size_t v = strtoull(s, &end, 10);
+    if (*end == 'K' || *end == 'k') v <<= 10;
+    if (*end == 'M' || *end == 'm') v <<= 20;
+    return v;
+}
+
+int main(int argc, char **argv) {
+    long long mb = 256;
+    int runs = 3;
+    const char *dir = ".", *cache = "hot", *tasks = "all";
+    size_t sizes[32] = { 4 << 10, 16 << 10, 64 << 10, 256 << 10, 1 << 20, 4 << 20 };
+    int n_sizes = 6;
+    int opt;
+    while ((opt = getopt(argc, argv, "s:r:d:c:t:b:h")) != -1) {
+        switch (opt) {
+        case 's': mb = atoll(optarg); break;
+        case 'r': runs = atoi(optarg); break;
+        case 'd': dir = optarg; break;
+        case 'c': cache = optarg; break;
+        case 't': tasks = optarg; break;
+        case 'b':
+            n_sizes = 0;
+            for (char *tok = strtok(optarg, ","); tok && n_sizes < 32; tok = strtok(NULL, ","))
+                sizes[n_sizes++] = parse_size(tok);
+            break;
+        default: usage(argv[0]); return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (mb <= 0 || runs < 1 || !n_sizes) {
+        usage(argv[0]);
+        return 1;
+    }
+    int do_tee = strcmp(tasks, "reverse") != 0, do_reverse = strcmp(tasks, "tee") != 0;
+    int hot = strcmp(cache, "cold") != 0, cold = strcmp(cache, "hot") != 0;
+
+    counters = mmap(NULL, sizeof(*counters), PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (counters == MAP_FAILED) {
+        perror("mmap");
+        return 1;
+    }
+    char input[4096], output[4096];
+    snprintf(input, sizeof(input), "%s/bench_input", dir);
+    snprintf(output, sizeof(output), "%s/bench_output", dir);
+    long long size = mb << 20;
+    if (generate(input, size, 0) == -1) {
+        perror("generating the input");
+        return 1;
+    }
+
+    printf("%lld MiB, best of %d; syscalls counted: read write pread pwrite lseek mmap "
+           "munmap madvise ftruncate fcntl syscall\n", mb, runs);
+    for (int pass = 0; pass < 2; ++pass) {
+        int is_cold = pass == 1;
+        if (is_cold ? !cold : !hot)
+            continue;
+        if (is_cold && generate(input, size, 1) == -1) {
+            perror("generating the input");
+            return 1;
+        }
+        printf("\n[%s cache]\n%-8s %-9s %9s %9s %12s %10s\n", is_cold ? "cold" : "hot",
+               "task", "strategy", "buffer", "MB/s", "syscalls/MB", "RSS KiB");
+
+        for (size_t i = 0; do_tee && i < sizeof(tee_strategies) / sizeof(tee_strategies[0]); ++i) {
+            for (int b = 0; b < n_sizes; ++b) {
+                struct result best = { 0 }, res;
+                for (int r = 0; r < runs; ++r) {
+                    if (is_cold)
+                        drop_cache(input);
+                    if (run_tee(tee_strategies[i].strategy, input, output, size, sizes[b], &res) == -1) {
+                        fprintf(stderr, "tee %s failed\n", tee_strategies[i].name);
+                        return 1;
+                    }
+                    if (!best.seconds || res.seconds < best.seconds)
+                        best = res;
+                }
+                report("tee", tee_strategies[i].name, sizes[b], size, &best);
+            }
+        }
+        for (size_t i = 0; do_reverse && i < sizeof(reverse_strategies) / sizeof(reverse_strategies[0]); ++i) {
+            int n = reverse_strategies[i].sized ? n_sizes : 1;
+            for (int b = 0; b < n; ++b) {
+                size_t bs = reverse_strategies[i].sized ? sizes[b] : 0;
+                struct result best = { 0 }, res;
+                for (int r = 0; r < runs; ++r) {
+                    if (is_cold)
+                        drop_cache(input);
+                    if (run_reverse(reverse_strategies[i].strategy, input, output, size, bs, &res) == -1) {
+                        fprintf(stderr, "reverse %s failed\n", reverse_strategies[i].name);
+                        return 1;
+                    }
+                    if (!best.seconds || res.seconds < best.seconds)
+                        best = res;
+                }
+                report("reverse", reverse_strategies[i].name, bs, size, &best);
+            }
+        }
+    }
+    unlink(input);
+    unlink(output);
+    return 0;
+}
@@ -0,0 +1,80 @@
+#ifndef FILE_OPS_H__
+#define FILE_OPS_H__
+
+#include <stddef.h>
+
+/* Buffer size of the read/write strategies, for benchmarks. 0 restores the
+ * built-in sizes (8 KiB tee and reverse_file, 64 KiB reverse_file_optimized,
+ * 256 KiB pipeline blocks and io_uring chunks, 1 MiB stream chunks). Not
+ * thread-safe; set it before starting any operation. */
+void file_ops_set_buffer_size(size_t size);
+
+/* The configured buffer size, or fallback if none is set */
+size_t file_ops_buffer_size(size_t fallback);
+
+/* Writes exactly count bytes, retrying short writes and EINTR. Every
+ * strategy writes through it. Returns 0 on success, -1 on error. */
+int file_ops_full_write(int fd, const void *buf, size_t count);
+
+/* How tee_with() moves the data from stdin to stdout and the file */
+enum tee_strategy {
+    TEE_BUFFERED,   /* read() into a user buffer, write() it twice */
+    TEE_SPLICE,     /* tee(2)/splice(2) inside the kernel, falls back to
+                       TEE_BUFFERED unless stdin and stdout are pipes */
+    TEE_URING,      /* tee_multi() with a single file */
+    TEE_PIPELINE,   /* reader, stdout writer and file writer threads */
+};
+
+int tee(const char *output_file);
+int tee_with(const char *output_file, enum tee_strategy strategy);
+
+/* Copies stdin to stdout and to every one of the n_files output files. The
+ * writes go through io_uring so a slow sink does not stall the others; falls
+ * back to plain read/write loops where io_uring is not available. */
+int tee_multi(const char *const output_files[], int n_files);
+
+/* How reverse_file_with() reverses a file */
+enum reverse_strategy {
+    REVERSE_CHUNKED,    /* 64 KiB blocks from the end: lseek, read, write */
+    REVERSE_MMAP,       /* windows of both files mapped, reversed by all
+                           cores; falls back to REVERSE_CHUNKED for inputs
+                           that cannot be mapped */
+    REVERSE_PIPELINE,   /* reads, reversals and writes of different blocks
+                           overlap on three threads (io_pipeline.h) */
+    REVERSE_STREAM,     /* reverse_stream(), also used by every strategy
+                           when the input cannot seek */
+    REVERSE_DIRECT,     /* O_DIRECT with aligned 1 MiB blocks, bypasses the
+                           page cache (reverse_fd_direct) */
+};
+
+/* Memory reverse_stream() may use before it spills to a temporary file */
+#ifndef REVERSE_STREAM_BUDGET
+#define REVERSE_STREAM_BUDGET (64 << 20)
+#endif
+
+int reverse_file(const char *input_file, const char *output_file);
+int reverse_file_optimized(const char *input_file, const char *output_file);
+int reverse_file_with(const char *input_file, const char *output_file,
+                      enum reverse_strategy strategy);
+
+/* Reverses the order of lines (record_size 0, like tac) or of fixed-size
+ * records; the bytes inside a record keep their order */
+int reverse_file_records(const char *input_file, const char *output_file, size_t record_size);
+
+/* Reverses a regular file into out_fd (opened O_RDWR) through mmap.
+ * Returns 0 on success, -1 on error and 1 if in_fd cannot be mapped or the
+ * space for the output cannot be reserved. */
+int reverse_fd_mmap(int in_fd, int out_fd);
+
+/* Reverses a regular file into out_fd with O_DIRECT on both descriptors.
+ * A file system without O_DIRECT gets buffered I/O whose pages are dropped
+ * with posix_fadvise once written. Returns 0 on success, -1 on error and 1
+ * if in_fd is not a regular file. */
+int reverse_fd_direct(int in_fd, int out_fd);
+
+/* Reverses a stream that cannot seek: reads it forward, keeps up to
+ * memory_budget bytes in memory and spills the rest to an unlinked file in
+ * $TMPDIR (or /tmp). Returns 0 on success, -1 on error. */
+int reverse_stream(int in_fd, int out_fd, size_t memory_budget);
+
+#endif /* FILE_OPS_H__ */
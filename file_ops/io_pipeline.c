@@ -0,0 +1,188 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include "io_pipeline.h"
+
+/* Block index that tells the next stage there is nothing more */
+#define END_OF_STREAM -1
+
+struct block {
+    char *data;
+    size_t len;
+};
+
+struct pipeline {
+    struct block *blocks;
+    size_t block_size;
+    struct block_ring free_ring;    /* writer -> reader */
+    struct block_ring full_ring;    /* reader -> transform */
+    struct block_ring done_ring;    /* transform -> writer */
+
+    io_read_fn read_block;
+    io_transform_fn transform;
+    io_write_fn write_block;
+    void *ctx;
+    atomic_int failed;
+};
+
+static int block_ring_init(struct block_ring *br, int size) {
+    br->slots = malloc(sizeof(int) * (size_t)size);
+    if (!br->slots)
+        return -1;
+    br->size = size;
+    br->idx_reader = 0;
+    br->idx_writer = 0;
+    sem_init(&br->mutex, 0, 1);
+    sem_init(&br->free, 0, (unsigned)size);
+    sem_init(&br->items, 0, 0);
+    return 0;
+}
+
+static void block_ring_destroy(struct block_ring *br) {
+    sem_destroy(&br->mutex);
+    sem_destroy(&br->free);
+    sem_destroy(&br->items);
+    free(br->slots);
+}
+
+static void sem_wait_intr(sem_t *s) {
+    while (sem_wait(s) == -1)
+        ;   /* EINTR */
+}
+
+static int block_ring_read(struct block_ring *br) {
+    sem_wait_intr(&br->items);
+    sem_wait_intr(&br->mutex);
+
+    int val = br->slots[br->idx_reader];
+    br->idx_reader = (br->idx_reader + 1) % br->size;
+
+    sem_post(&br->mutex);
+    sem_post(&br->free);
+    return val;
+}
+
+static void block_ring_write(struct block_ring *br, int value) {
+    sem_wait_intr(&br->free);
+    sem_wait_intr(&br->mutex);
+
+    br->slots[br->idx_writer] = value;
+    br->idx_writer = (br->idx_writer + 1) % br->size;
+
+    sem_post(&br->mutex);
+    sem_post(&br->items);
+}
+
+static void *reader_stage(void *arg) {
+    struct pipeline *p = arg;
+    struct block_ring *out = p->transform ? &p->full_ring : &p->done_ring;
+    for (long long seq = 0; !atomic_load(&p->failed); ++seq) {
+        int b = block_ring_read(&p->free_ring);
+        ssize_t n = p->read_block(p->ctx, p->blocks[b].data, p->block_size, seq);
+        if (n <= 0) {
+            if (n < 0)
+                atomic_store(&p->failed, 1);
+            block_ring_write(&p->free_ring, b);
+            break;
+        }
+        p->blocks[b].len = (size_t)n;
+        block_ring_write(out, b);
+    }
+    block_ring_write(out, END_OF_STREAM);
+    return NULL;
+}
+
+static void *transform_stage(void *arg) {
+    struct pipeline *p = arg;
+    for (;;) {
+        int b = block_ring_read(&p->full_ring);
+        if (b == END_OF_STREAM)
+            break;
+        /* after a failure keep draining so the reader is not left blocked */
+        if (!atomic_load(&p->failed) &&
+            p->transform(p->ctx, p->blocks[b].data, p->blocks[b].len) == -1)
+            atomic_store(&p->failed, 1);
+        block_ring_write(&p->done_ring, b);
+    }
+    block_ring_write(&p->done_ring, END_OF_STREAM);
+    return NULL;
+}
+
+int io_pipeline_run(size_t block_size, int n_blocks, io_read_fn read_block,
+                    io_transform_fn transform, io_write_fn write_block, void *ctx) {
+    if (!block_size || n_blocks < 1 || !read_block || !write_block)
+        return -1;
+
+    struct pipeline p = {
+        .block_size = block_size,
+        .read_block = read_block,
+        .transform = transform,
+        .write_block = write_block,
+        .ctx = ctx,
+    };
+    atomic_init(&p.failed, 0);
+
+    /* each ring also has to hold the end-of-stream marker */
+    char *mem = malloc(block_size * (size_t)n_blocks);
+    p.blocks = malloc(sizeof(*p.blocks) * (size_t)n_blocks);
+    if (!mem || !p.blocks) {
+        free(mem);
+        free(p.blocks);
+        return -1;
+    }
+    if (block_ring_init(&p.free_ring, n_blocks) == -1)
+        goto fail_free;
+    if (block_ring_init(&p.full_ring, n_blocks + 1) == -1)
+        goto fail_free_ring;
+    if (block_ring_init(&p.done_ring, n_blocks + 1) == -1)
+        goto fail_full_ring;
+    for (int i = 0; i < n_blocks; ++i) {
+        p.blocks[i].data = mem + (size_t)i * block_size;
+        block_ring_write(&p.free_ring, i);
+    }
+
+    pthread_t reader, transformer;
+    if (transform && pthread_create(&transformer, NULL, transform_stage, &p) != 0)
+        goto fail_done_ring;
+    if (pthread_create(&reader, NULL, reader_stage, &p) != 0) {
+        if (transform) {
+            block_ring_write(&p.full_ring, END_OF_STREAM);
+            pthread_join(transformer, NULL);
+        }
+        goto fail_done_ring;
+    }
+
+    /* writer stage on this thread */
+    for (;;) {
+        int b = block_ring_read(&p.done_ring);
+        if (b == END_OF_STREAM)
+            break;
+        if (!atomic_load(&p.failed) &&
+            p.write_block(ctx, p.blocks[b].data, p.blocks[b].len) == -1)
+            atomic_store(&p.failed, 1);
+        block_ring_write(&p.free_ring, b);
+    }
+
+    pthread_join(reader, NULL);
+    if (transform)
+        pthread_join(transformer, NULL);
+    int ret = atomic_load(&p.failed) ? -1 : 0;
+
+    block_ring_destroy(&p.done_ring);
+    block_ring_destroy(&p.full_ring);
+    block_ring_destroy(&p.free_ring);
+    free(p.blocks);
+    free(mem);
+    return ret;
+
+fail_done_ring:
+    block_ring_destroy(&p.done_ring);
+fail_full_ring:
+    block_ring_destroy(&p.full_ring);
+fail_free_ring:
+    block_ring_destroy(&p.free_ring);
+fail_free:
+    free(p.blocks);
+    free(mem);
+    return -1;
+}
@@ -0,0 +1,45 @@
+#ifndef IO_PIPELINE_H__
+#define IO_PIPELINE_H__
+
+#include <semaphore.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+/*
+ * Three-stage I/O pipeline: a reader thread fills blocks, a transform thread
+ * processes them and the calling thread writes them out. The stages hand
+ * blocks to each other through bounded rings of block indices (semaphores,
+ * like struct BufferRing in ipc/), and finished blocks go back to a free
+ * ring. Reads, transforms and writes of different blocks overlap, while the
+ * memory stays at n_blocks * block_size.
+ *
+ * Blocks reach the transform and the writer in the order they were read.
+ */
+
+/* Fills buf with up to size bytes, the seq-th block of the stream.
+ * Returns the bytes read, 0 at the end and -1 on error. */
+typedef ssize_t (*io_read_fn)(void *ctx, char *buf, size_t size, long long seq);
+
+/* Processes a block in place; returns 0 or -1 on error */
+typedef int (*io_transform_fn)(void *ctx, char *buf, size_t len);
+
+/* Writes a block out; returns 0 or -1 on error */
+typedef int (*io_write_fn)(void *ctx, const char *buf, size_t len);
+
+struct block_ring {
+    int *slots;
+    int idx_reader;
+    int idx_writer;
+    int size;
+
+    sem_t mutex;
+    sem_t free;
+    sem_t items;
+};
+
+/* Runs the pipeline until the reader reaches the end or a stage fails.
+ * transform may be NULL. Returns 0 on success, -1 on error. */
+int io_pipeline_run(size_t block_size, int n_blocks, io_read_fn read_block,
+                    io_transform_fn transform, io_write_fn write_block, void *ctx);
+
+#endif /* IO_PIPELINE_H__ */
@@ -0,0 +1,176 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+/* _GNU_SOURCE makes fcntl.h declare the libc tee() */
+#define tee file_ops_tee
+#include "file_ops.h"
+#undef tee
+#include "reverse_simd.h"
+#include "../metrics/metrics.h"
+
+/*
+ * Reverse that stays out of the page cache.
+ *
+ * Both files are switched to O_DIRECT. Output block k covers the output
+ * range [k*B, (k+1)*B), which is the input range [S-(k+1)*B, S-k*B) in
+ * reverse. That input range is generally not aligned, so the aligned
+ * superset around it is read and the reversal starts at the right offset.
+ * Output offsets are multiples of B and thus aligned. Only the last block
+ * can be short: it is padded to the alignment and ftruncate cuts the file
+ * back to S at the end.
+ *
+ * Where a file system refuses O_DIRECT, that file falls back to buffered
+ * I/O. posix_fadvise then drops the input behind the reader. The output is
+ * pushed to disk with sync_file_range one block behind the writer and
+ * dropped as well, so the cache never holds more than a few blocks.
+ */
+
+#define DIRECT_ALIGN 4096
+#define DIRECT_BLOCK (1 << 20)
+
+#ifndef SYNC_FILE_RANGE_WAIT_BEFORE
+#define SYNC_FILE_RANGE_WAIT_BEFORE 1
+#define SYNC_FILE_RANGE_WRITE       2
+#define SYNC_FILE_RANGE_WAIT_AFTER  4
+#endif
+
+struct direct_fd {
+    int fd;
+    int direct;
+};
+
+static void direct_enable(struct direct_fd *f) {
+    int flags = fcntl(f->fd, F_GETFL);
+    f->direct = flags != -1 && fcntl(f->fd, F_SETFL, flags | O_DIRECT) == 0;
+}
+
+/* Some file systems accept the flag but fail the I/O: go buffered */
+static int direct_refused(struct direct_fd *f) {
+    if (!f->direct || errno != EINVAL)
+        return 0;
+    int flags = fcntl(f->fd, F_GETFL);
+    if (flags == -1 || fcntl(f->fd, F_SETFL, flags & ~O_DIRECT) == -1)
+        return 0;
+    f->direct = 0;
+    return 1;
+}
+
+/* Reads until len bytes or end of file; returns the bytes read or -1 */
+static ssize_t pread_full(struct direct_fd *f, char *buf, size_t len, off_t off) {
+    size_t got = 0;
+    while (got < len) {
+        ssize_t r = pread(f->fd, buf + got, len - got, off + (off_t)got);
+        if (r < 0 && (errno == EINTR || direct_refused(f)))
+            continue;
+        if (r < 0)
+            return -1;
+        if (r == 0)
+            break;
+        got += (size_t)r;
+    }
+    return (ssize_t)got;
+}
+
+static int pwrite_full(struct direct_fd *f, const char *buf, size_t len, off_t off) {
+    METRIC_TIMER(t0);
+    while (len > 0) {
+        ssize_t w = pwrite(f->fd, buf, len, off);
+        METRIC_INC(CNT_FILE_WRITES);
+        if (w < 0 && (errno == EINTR || direct_refused(f)))
+            continue;
+        if (w <= 0)
+            return -1;
+        METRIC_ADD(CNT_FILE_BYTES_WRITTEN, w);
+        buf += w;
+        off += w;
+        len -= (size_t)w;
+    }
+    METRIC_ELAPSED(HIST_FILE_WRITE_NS, t0);
+    return 0;
+}
+
+static int sync_range(int fd, off_t off, off_t len, unsigned flags) {
+    return (int)syscall(SYS_sync_file_range, fd, off, len, flags);
+}
+
+int reverse_fd_direct(int in_fd, int out_fd) {
+    struct stat st;
+    if (fstat(in_fd, &st) == -1)
+        return -1;
+    if (!S_ISREG(st.st_mode))
+        return 1;
+    off_t size = st.st_size;
+
+    const off_t A = DIRECT_ALIGN;
+    size_t block = file_ops_buffer_size(DIRECT_BLOCK);
+    block = (block + (size_t)A - 1) / (size_t)A * (size_t)A;
+
+    char *in_buf = NULL, *out_buf = NULL;
+    if (posix_memalign((void **)&in_buf, (size_t)A, block + 2 * (size_t)A) ||
+        posix_memalign((void **)&out_buf, (size_t)A, block)) {
+        free(in_buf);
+        return -1;
+    }
+
+    struct direct_fd in = { in_fd, 0 }, out = { out_fd, 0 };
+    direct_enable(&in);
+    direct_enable(&out);
+    /* the hints only matter for a side that ends up buffered */
+    posix_fadvise(in_fd, 0, 0, POSIX_FADV_NOREUSE);
+
+    int ret = 0;
+    for (off_t out_off = 0; out_off < size; out_off += (off_t)block) {
+        size_t n = size - out_off < (off_t)block ? (size_t)(size - out_off) : block;
+        off_t end = size - out_off, start = end - (off_t)n;
+        off_t lo = start / A * A;
+        off_t hi = (end + A - 1) / A * A;
+
+        ssize_t got = pread_full(&in, in_buf, (size_t)(hi - lo), lo);
+        if (got < end - lo) {
+            ret = -1;
+            break;
+        }
+        reverse_copy(out_buf, in_buf + (start - lo), n);
+
+        size_t len = n;
+        if (out.direct && n % (size_t)A) {
+            len = (n + (size_t)A - 1) / (size_t)A * (size_t)A;
+            memset(out_buf + n, 0, len - n);
+        }
+        if (pwrite_full(&out, out_buf, len, out_off) == -1) {
+            ret = -1;
+            break;
+        }
+
+        if (!in.direct)
+            posix_fadvise(in_fd, lo, hi - lo, POSIX_FADV_DONTNEED);
+        if (!out.direct) {
+            /* start writeback of this block, wait for the previous one and
+             * drop it from the cache */
+            sync_range(out_fd, out_off, (off_t)n, SYNC_FILE_RANGE_WRITE);
+            if (out_off >= (off_t)block) {
+                off_t prev = out_off - (off_t)block;
+                sync_range(out_fd, prev, (off_t)block, SYNC_FILE_RANGE_WAIT_BEFORE |
+                           SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER);
+                posix_fadvise(out_fd, prev, (off_t)block, POSIX_FADV_DONTNEED);
+            }
+        }
+    }
+
+    /* cut off the padding of the last block */
+    if (ret == 0 && ftruncate(out_fd, size) == -1)
+        ret = -1;
+    if (ret == 0 && !out.direct) {
+        fdatasync(out_fd);
+        posix_fadvise(out_fd, 0, 0, POSIX_FADV_DONTNEED);
+    }
+    free(in_buf);
+    free(out_buf);
+    return ret;
+}
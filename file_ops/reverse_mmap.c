@@ -0,0 +1,114 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "file_ops.h"
+#include "reverse_simd.h"
+#include "../metrics/metrics.h"
+
+/*
+ * mmap-based reverse: the output is sized with ftruncate and its blocks are
+ * reserved with posix_fallocate, so a full disk shows up as an error here
+ * and not as SIGBUS on a store into a sparse page. Both files are mapped
+ * window by window. Worker thread t takes windows t, t + T, ...
+ * and reverses each one straight into the mirrored range of the output, so
+ * no thread waits for another and at most T windows are mapped at a time.
+ */
+
+#define MMAP_WINDOW      (16 << 20)
+#define MMAP_MAX_THREADS 16
+
+struct mmap_job {
+    int in_fd, out_fd;
+    off_t size;
+    int thread, n_threads;
+    int ret;    /* -1 on error, 1 to fall back to the chunked reverse */
+};
+
+static void *reverse_windows(void *arg) {
+    struct mmap_job *j = arg;
+    off_t page = (off_t)sysconf(_SC_PAGESIZE);
+
+    for (off_t off = (off_t)j->thread * MMAP_WINDOW; off < j->size;
+         off += (off_t)j->n_threads * MMAP_WINDOW) {
+        size_t len = j->size - off < MMAP_WINDOW ? (size_t)(j->size - off) : MMAP_WINDOW;
+
+        /* the mirrored output range is generally not page aligned */
+        off_t out_off = j->size - off - (off_t)len;
+        off_t out_base = out_off & ~(page - 1);
+        size_t delta = (size_t)(out_off - out_base);
+
+        char *in = mmap(NULL, len, PROT_READ, MAP_SHARED, j->in_fd, off);
+        if (in == MAP_FAILED) {
+            j->ret = -1;
+            return NULL;
+        }
+        char *out = mmap(NULL, len + delta, PROT_READ | PROT_WRITE, MAP_SHARED,
+                         j->out_fd, out_base);
+        if (out == MAP_FAILED) {
+            munmap(in, len);
+            j->ret = -1;
+            return NULL;
+        }
+        /* the output is written back to front: no MADV_SEQUENTIAL there,
+         * it makes the kernel drop the pages just written. Pre-faulting the
+         * whole window saves one write fault per page. */
+        madvise(in, len, MADV_SEQUENTIAL);
+#ifdef MADV_POPULATE_WRITE
+        /* EINVAL: kernel without MADV_POPULATE_WRITE, the stores fault the
+         * pages in. Anything else means they cannot be backed. */
+        if (madvise(out, len + delta, MADV_POPULATE_WRITE) == -1 && errno != EINVAL) {
+            munmap(out, len + delta);
+            munmap(in, len);
+            j->ret = 1;
+            return NULL;
+        }
+#endif
+
+        reverse_copy(out + delta, in, len);
+        METRIC_ADD(CNT_FILE_BYTES_WRITTEN, len);
+
+        munmap(out, len + delta);
+        /* done with the input, let the kernel drop it first */
+        madvise(in, len, MADV_DONTNEED);
+        munmap(in, len);
+    }
+    return NULL;
+}
+
+int reverse_fd_mmap(int in_fd, int out_fd) {
+    struct stat st;
+    if (fstat(in_fd, &st) == -1 || !S_ISREG(st.st_mode) || st.st_size == 0)
+        return 1;
+    if (ftruncate(out_fd, st.st_size) == -1 || posix_fallocate(out_fd, 0, st.st_size) != 0)
+        return 1;
+
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    off_t windows = (st.st_size + MMAP_WINDOW - 1) / MMAP_WINDOW;
+    int n = cpus < 1 ? 1 : cpus > MMAP_MAX_THREADS ? MMAP_MAX_THREADS : (int)cpus;
+    if (windows < n)
+        n = (int)windows;
+
+    struct mmap_job jobs[MMAP_MAX_THREADS];
+    pthread_t threads[MMAP_MAX_THREADS];
+    int started = 0, ret = 0;
+    for (int i = 0; i < n; ++i)
+        jobs[i] = (struct mmap_job){ in_fd, out_fd, st.st_size, i, n, 0 };
+    /* the last share runs on this thread */
+    for (; started < n - 1; ++started) {
+        if (pthread_create(&threads[started], NULL, reverse_windows, &jobs[started]) != 0) {
+            ret = -1;
+            break;
+        }
+    }
+    if (ret == 0)
+        reverse_windows(&jobs[n - 1]);
+    for (int i = 0; i < started; ++i)
+        pthread_join(threads[i], NULL);
+    for (int i = 0; i < n && ret != -1; ++i)
+        if (jobs[i].ret)
+            ret = jobs[i].ret;
+    return ret;
+}
@@ -0,0 +1,234 @@
+#include <stdint.h>
+#include <string.h>
+#include "reverse_simd.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86 1
+#endif
+
+/* ----- scalar ----- */
+
+static void reverse_bytes_scalar(char *buf, size_t n) {
+    char *lo = buf, *hi = buf + n;
+    while (hi - lo >= 16) {
+        uint64_t a, b;
+        hi -= 8;
+        memcpy(&a, lo, 8);
+        memcpy(&b, hi, 8);
+        a = __builtin_bswap64(a);
+        b = __builtin_bswap64(b);
+        memcpy(lo, &b, 8);
+        memcpy(hi, &a, 8);
+        lo += 8;
+    }
+    while (hi - lo > 1) {
+        char t = *lo;
+        *lo++ = *--hi;
+        *hi = t;
+    }
+}
+
+static void reverse_copy_scalar(char *dst, const char *src, size_t n) {
+    char *d = dst + n;
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        uint64_t v;
+        memcpy(&v, src + i, 8);
+        v = __builtin_bswap64(v);
+        d -= 8;
+        memcpy(d, &v, 8);
+    }
+    for (; i < n; ++i)
+        *--d = src[i];
+}
+
+static const char *find_last_byte_scalar(const char *buf, int c, size_t n) {
+    while (n > 0)
+        if (buf[--n] == (char)c)
+            return buf + n;
+    return NULL;
+}
+
+#ifdef HAVE_X86
+
+/* ----- SSE2: compare 16 bytes, the highest set mask bit is the match ----- */
+
+__attribute__((target("sse2")))
+static const char *find_last_byte_sse2(const char *buf, int c, size_t n) {
+    const __m128i needle = _mm_set1_epi8((char)c);
+    while (n >= 16) {
+        n -= 16;
+        unsigned mask = (unsigned)_mm_movemask_epi8(
+            _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(buf + n)), needle));
+        if (mask)
+            return buf + n + 31 - __builtin_clz(mask);
+    }
+    return find_last_byte_scalar(buf, c, n);
+}
+
+/* ----- SSSE3: pshufb reverses a 16-byte lane ----- */
+
+__attribute__((target("ssse3")))
+static inline __m128i rev16(__m128i v) {
+    const __m128i mask = _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7,
+                                      8, 9, 10, 11, 12, 13, 14, 15);
+    return _mm_shuffle_epi8(v, mask);
+}
+
+/* Swaps and reverses 16-byte blocks from both ends towards the middle */
+__attribute__((target("ssse3")))
+static void reverse_bytes_ssse3(char *buf, size_t n) {
+    char *lo = buf, *hi = buf + n;
+    while (hi - lo >= 32) {
+        hi -= 16;
+        __m128i a = _mm_loadu_si128((const __m128i *)lo);
+        __m128i b = _mm_loadu_si128((const __m128i *)hi);
+        _mm_storeu_si128((__m128i *)lo, rev16(b));
+        _mm_storeu_si128((__m128i *)hi, rev16(a));
+        lo += 16;
+    }
+    reverse_bytes_scalar(lo, (size_t)(hi - lo));
+}
+
+__attribute__((target("ssse3")))
+static void reverse_copy_ssse3(char *dst, const char *src, size_t n) {
+    char *d = dst + n;
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        d -= 16;
+        _mm_storeu_si128((__m128i *)d, rev16(_mm_loadu_si128((const __m128i *)(src + i))));
+    }
+    reverse_copy_scalar(dst, src + i, n - i);
+}
+
+/* ----- AVX2: vpshufb reverses each 128-bit lane, vpermq swaps them ----- */
+
+__attribute__((target("avx2")))
+static inline __m256i rev32(__m256i v) {
+    const __m256i mask = _mm256_set_epi8(0, 1, 2, 3, 4, 5, 6, 7,
+                                         8, 9, 10, 11, 12, 13, 14, 15,
+                                         0, 1, 2, 3, 4, 5, 6, 7,
+                                         8, 9, 10, 11, 12, 13, 14, 15);
+    return _mm256_permute4x64_epi64(_mm256_shuffle_epi8(v, mask), 0x4e);
+}
+
+__attribute__((target("avx2")))
+static void reverse_bytes_avx2(char *buf, size_t n) {
+    char *lo = buf, *hi = buf + n;
+    while (hi - lo >= 64) {
+        hi -= 32;
+        __m256i a = _mm256_loadu_si256((const __m256i *)lo);
+        __m256i b = _mm256_loadu_si256((const __m256i *)hi);
+        _mm256_storeu_si256((__m256i *)lo, rev32(b));
+        _mm256_storeu_si256((__m256i *)hi, rev32(a));
+        lo += 32;
+    }
+    reverse_bytes_ssse3(lo, (size_t)(hi - lo));
+}
+
+__attribute__((target("avx2")))
+static void reverse_copy_avx2(char *dst, const char *src, size_t n) {
+    char *d = dst + n;
+    size_t i = 0;
+    for (; i + 64 <= n; i += 64) {
+        __m256i a = _mm256_loadu_si256((const __m256i *)(src + i));
+        __m256i b = _mm256_loadu_si256((const __m256i *)(src + i + 32));
+        d -= 64;
+        _mm256_storeu_si256((__m256i *)(d + 32), rev32(a));
+        _mm256_storeu_si256((__m256i *)d, rev32(b));
+    }
+    reverse_copy_ssse3(dst, src + i, n - i);
+}
+
+/* Two 32-byte compares per step, the later half is checked first */
+__attribute__((target("avx2")))
+static const char *find_last_byte_avx2(const char *buf, int c, size_t n) {
+    const __m256i needle = _mm256_set1_epi8((char)c);
+    while (n >= 64) {
+        n -= 64;
+        __m256i a = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(buf + n)), needle);
+        __m256i b = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(buf + n + 32)), needle);
+        if (_mm256_testz_si256(_mm256_or_si256(a, b), _mm256_or_si256(a, b)))
+            continue;
+        unsigned hi = (unsigned)_mm256_movemask_epi8(b);
+        if (hi)
+            return buf + n + 32 + 31 - __builtin_clz(hi);
+        return buf + n + 31 - __builtin_clz((unsigned)_mm256_movemask_epi8(a));
+    }
+    return find_last_byte_sse2(buf, c, n);
+}
+
+#endif /* HAVE_X86 */
+
+/* ----- dispatch ----- */
+
+static void reverse_bytes_resolve(char *buf, size_t n);
+static void reverse_copy_resolve(char *dst, const char *src, size_t n);
+static const char *find_last_byte_resolve(const char *buf, int c, size_t n);
+
+static void (*reverse_bytes_impl)(char *, size_t) = reverse_bytes_resolve;
+static void (*reverse_copy_impl)(char *, const char *, size_t) = reverse_copy_resolve;
+static const char *(*find_last_byte_impl)(const char *, int, size_t) = find_last_byte_resolve;
+static const char *kernel_name = "scalar";
+
+/* Every thread that races here stores the same pointers */
+static void resolve(void) {
+    void (*bytes)(char *, size_t) = reverse_bytes_scalar;
+    void (*copy)(char *, const char *, size_t) = reverse_copy_scalar;
+    const char *(*find)(const char *, int, size_t) = find_last_byte_scalar;
+    const char *name = "scalar";
+#ifdef HAVE_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        bytes = reverse_bytes_avx2;
+        copy = reverse_copy_avx2;
+        find = find_last_byte_avx2;
+        name = "avx2";
+    } else if (__builtin_cpu_supports("ssse3")) {
+        bytes = reverse_bytes_ssse3;
+        copy = reverse_copy_ssse3;
+        find = find_last_byte_sse2;
+        name = "ssse3";
+    } else if (__builtin_cpu_supports("sse2")) {
+        find = find_last_byte_sse2;
+    }
+#endif
+    __atomic_store_n(&kernel_name, name, __ATOMIC_RELAXED);
+    __atomic_store_n(&find_last_byte_impl, find, __ATOMIC_RELAXED);
+    __atomic_store_n(&reverse_copy_impl, copy, __ATOMIC_RELAXED);
+    __atomic_store_n(&reverse_bytes_impl, bytes, __ATOMIC_RELAXED);
+}
+
+static void reverse_bytes_resolve(char *buf, size_t n) {
+    resolve();
+    reverse_bytes_impl(buf, n);
+}
+
+static void reverse_copy_resolve(char *dst, const char *src, size_t n) {
+    resolve();
+    reverse_copy_impl(dst, src, n);
+}
+
+static const char *find_last_byte_resolve(const char *buf, int c, size_t n) {
+    resolve();
+    return find_last_byte_impl(buf, c, n);
+}
+
+void reverse_bytes(char *buf, size_t n) {
+    __atomic_load_n(&reverse_bytes_impl, __ATOMIC_RELAXED)(buf, n);
+}
+
+void reverse_copy(char *dst, const char *src, size_t n) {
+    __atomic_load_n(&reverse_copy_impl, __ATOMIC_RELAXED)(dst, src, n);
+}
+
+const char *find_last_byte(const char *buf, int c, size_t n) {
+    return __atomic_load_n(&find_last_byte_impl, __ATOMIC_RELAXED)(buf, c, n);
+}
+
+const char *reverse_kernel_name(void) {
+    if (__atomic_load_n(&reverse_bytes_impl, __ATOMIC_RELAXED) == reverse_bytes_resolve)
+        resolve();
+    return __atomic_load_n(&kernel_name, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,25 @@
+#ifndef REVERSE_SIMD_H__
+#define REVERSE_SIMD_H__
+
+#include <stddef.h>
+
+/*
+ * Byte reversal kernels. The first call picks the widest implementation the
+ * CPU supports (AVX2 32-byte lanes, SSSE3 16-byte lanes, scalar 8-byte
+ * bswap); later calls go straight to it. find_last_byte() is dispatched the
+ * same way (AVX2, SSE2, scalar).
+ */
+
+/* Reverses buf[0 .. n) in place */
+void reverse_bytes(char *buf, size_t n);
+
+/* dst[0 .. n) = src[n-1 .. 0]; the ranges must not overlap */
+void reverse_copy(char *dst, const char *src, size_t n);
+
+/* Last occurrence of c in buf[0 .. n), like memrchr(); NULL if there is none */
+const char *find_last_byte(const char *buf, int c, size_t n);
+
+/* Name of the implementation in use ("avx2", "ssse3" or "scalar") */
+const char *reverse_kernel_name(void);
+
+#endif /* REVERSE_SIMD_H__ */
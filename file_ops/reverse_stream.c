@@ -0,0 +1,128 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "file_ops.h"
+#include "reverse_simd.h"
+
+/*
+ * Streaming reverse for inputs that cannot seek (pipes, sockets).
+ *
+ * The input is read forward into fixed-size chunks. The newest chunks stay
+ * in a ring of buffers that fits the memory budget; when the ring is full
+ * the oldest chunk is appended to an unlinked temporary file. At the end
+ * the chunks in memory are written out newest first, then the spilled ones
+ * are read back from the end of the spill file, each one reversed. All
+ * chunks but the last are full, so chunk i sits at offset i * chunk in the
+ * spill file.
+ */
+
+#define STREAM_CHUNK     (1 << 20)
+#define STREAM_MIN_CHUNK 4096
+
+/* Reads until buf is full or the input ends; returns the bytes read */
+static ssize_t fill(int fd, char *buf, size_t size) {
+    size_t got = 0;
+    while (got < size) {
+        ssize_t r = read(fd, buf + got, size - got);
+        if (r < 0 && errno == EINTR)
+            continue;
+        if (r < 0)
+            return -1;
+        if (r == 0)
+            break;
+        got += (size_t)r;
+    }
+    return (ssize_t)got;
+}
+
+static int spill_open(void) {
+    const char *dir = getenv("TMPDIR");
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/reverse-spill-XXXXXX", dir && *dir ? dir : "/tmp");
+    int fd = mkstemp(path);
+    if (fd != -1)
+        unlink(path);   /* gone as soon as it is closed */
+    return fd;
+}
+
+int reverse_stream(int in_fd, int out_fd, size_t memory_budget) {
+    size_t chunk = file_ops_buffer_size(STREAM_CHUNK);
+    if (chunk > memory_budget)
+        chunk = memory_budget;
+    if (chunk < STREAM_MIN_CHUNK)
+        chunk = STREAM_MIN_CHUNK;
+    int cap = memory_budget / chunk > 1 ? (int)(memory_budget / chunk) : 1;
+
+    char **ring = calloc((size_t)cap, sizeof(*ring));
+    size_t *lens = calloc((size_t)cap, sizeof(*lens));
+    if (!ring || !lens) {
+        free(ring);
+        free(lens);
+        return -1;
+    }
+
+    int ret = -1, spill_fd = -1;
+    int first = 0, n = 0;           /* oldest chunk in the ring, chunks in it */
+    long long spilled = 0;          /* chunks in the spill file */
+
+    for (;;) {
+        int slot;
+        if (n == cap) {
+            /* ring full: the oldest chunk goes to disk, its buffer is reused */
+            if (spill_fd == -1 && (spill_fd = spill_open()) == -1)
+                goto out;
+            if (file_ops_full_write(spill_fd, ring[first], lens[first]) == -1)
+                goto out;
+            spilled++;
+            slot = first;
+            first = (first + 1) % cap;
+            n--;
+        } else {
+            slot = (first + n) % cap;
+            if (!ring[slot] && !(ring[slot] = malloc(chunk)))
+                goto out;
+        }
+
+        ssize_t r = fill(in_fd, ring[slot], chunk);
+        if (r < 0)
+            goto out;
+        if (r == 0)
+            break;
+        lens[slot] = (size_t)r;
+        n++;
+        if ((size_t)r < chunk)
+            break;  /* short fill only at the end */
+    }
+
+    /* newest chunks first, from memory */
+    for (int i = n - 1; i >= 0; --i) {
+        int slot = (first + i) % cap;
+        reverse_bytes(ring[slot], lens[slot]);
+        if (file_ops_full_write(out_fd, ring[slot], lens[slot]) == -1)
+            goto out;
+    }
+
+    /* then the spilled ones, back to front */
+    char *buf = ring[first];
+    if (spilled && !buf && !(buf = ring[first] = malloc(chunk)))
+        goto out;
+    for (long long i = spilled - 1; i >= 0; --i) {
+        if (pread(spill_fd, buf, chunk, (off_t)(i * (long long)chunk)) != (ssize_t)chunk)
+            goto out;
+        reverse_bytes(buf, chunk);
+        if (file_ops_full_write(out_fd, buf, chunk) == -1)
+            goto out;
+    }
+    ret = 0;
+
+out:
+    if (spill_fd != -1)
+        close(spill_fd);
+    for (int i = 0; i < cap; ++i)
+        free(ring[i]);
+    free(ring);
+    free(lens);
+    return ret;
+}
@@ -0,0 +1,376 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include "file_ops.h"
+#include "../metrics/metrics.h"
+
+/*
+ * Fan-out tee on io_uring (raw syscalls, no liburing).
+ *
+ * stdin is read into a ring of URING_CHUNKS registered buffers. For every
+ * chunk one write per sink (stdout + each file) is queued and the whole
+ * batch goes to the kernel with a single io_uring_enter(). A chunk is
+ * reused once every sink has written it, so a slow sink only holds back
+ * the reader after it falls URING_CHUNKS chunks behind; the other sinks
+ * keep going at their own pace.
+ *
+ * Seekable sinks get explicit offsets and may have all their chunks in
+ * flight at once. Pipes, terminals and O_APPEND files have a single write
+ * in flight, which keeps their output in order.
+ */
+
+#define URING_CHUNKS     8
+#define URING_CHUNK_SIZE (256 * 1024)
+#define BUF_SIZE         8192
+
+struct uring {
+    int fd;
+    unsigned features;
+    void *sq_map, *cq_map;
+    size_t sq_map_len, cq_map_len;
+    unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_sqe *sqes;
+    size_t sqes_len;
+    struct io_uring_cqe *cqes;
+    unsigned sq_entries;
+    unsigned to_submit;
+    int broken;         /* gave up with writes in flight, see tee_multi() */
+};
+
+struct chunk {
+    char *data;
+    size_t len;
+    long long offset;   /* position in the stream */
+    int refs;           /* sinks that still have to write it */
+};
+
+struct sink {
+    int fd;
+    int ordered;        /* one write in flight, no explicit offsets */
+    long long base;     /* file offset of stream position 0 */
+    long long next;     /* next chunk (sequence number) to queue */
+    int inflight;
+    size_t done[URING_CHUNKS];  /* bytes of each chunk written so far */
+};
+
+static int uring_setup(struct uring *u, unsigned entries) {
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    memset(u, 0, sizeof(*u));
+    u->fd = (int)syscall(__NR_io_uring_setup, entries, &p);
+    if (u->fd < 0)
+        return -1;
+    u->features = p.features;
+    u->sq_entries = p.sq_entries;
+
+    u->sq_map_len = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    u->cq_map_len = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        if (u->cq_map_len > u->sq_map_len)
+            u->sq_map_len = u->cq_map_len;
+        u->cq_map_len = 0;
+    }
+    u->sq_map = mmap(NULL, u->sq_map_len, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_SQ_RING);
+    if (u->sq_map == MAP_FAILED)
+        goto fail_fd;
+    if (u->cq_map_len) {
+        u->cq_map = mmap(NULL, u->cq_map_len, PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_CQ_RING);
+        if (u->cq_map == MAP_FAILED)
+            goto fail_sq;
+    } else {
+        u->cq_map = u->sq_map;
+    }
+    u->sqes_len = p.sq_entries * sizeof(struct io_uring_sqe);
+    u->sqes = mmap(NULL, u->sqes_len, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_SQES);
+    if (u->sqes == MAP_FAILED)
+        goto fail_cq;
+
+    char *sq = u->sq_map, *cq = u->cq_map;
+    u->sq_head  = (unsigned *)(sq + p.sq_off.head);
+    u->sq_tail  = (unsigned *)(sq + p.sq_off.tail);
+    u->sq_mask  = (unsigned *)(sq + p.sq_off.ring_mask);
+    u->sq_array = (unsigned *)(sq + p.sq_off.array);
+    u->cq_head  = (unsigned *)(cq + p.cq_off.head);
+    u->cq_tail  = (unsigned *)(cq + p.cq_off.tail);
+    u->cq_mask  = (unsigned *)(cq + p.cq_off.ring_mask);
+    u->cqes     = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+    return 0;
+
+fail_cq:
+    if (u->cq_map_len)
+        munmap(u->cq_map, u->cq_map_len);
+fail_sq:
+    munmap(u->sq_map, u->sq_map_len);
+fail_fd:
+    close(u->fd);
+    return -1;
+}
+
+static void uring_free(struct uring *u) {
+    munmap(u->sqes, u->sqes_len);
+    if (u->cq_map_len)
+        munmap(u->cq_map, u->cq_map_len);
+    munmap(u->sq_map, u->sq_map_len);
+    close(u->fd);
+}
+
+static int uring_enter(struct uring *u, unsigned min_complete) {
+    for (;;) {
+        long r = syscall(__NR_io_uring_enter, u->fd, u->to_submit, min_complete,
+                         min_complete ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+        if (r >= 0) {
+            u->to_submit -= (unsigned)r;
+            return 0;
+        }
+        if (errno != EINTR)
+            return -1;
+    }
+}
+
+/* Returns a zeroed SQE, submitting what is queued if the ring is full. The
+ * ring is sized for every write that can be in flight, so this only spins
+ * on submission, never on completions. */
+static struct io_uring_sqe *uring_get_sqe(struct uring *u) {
+    unsigned tail = *u->sq_tail;
+    while (tail - __atomic_load_n(u->sq_head, __ATOMIC_ACQUIRE) >= u->sq_entries) {
+        if (uring_enter(u, 0) == -1)
+            return NULL;
+    }
+    unsigned idx = tail & *u->sq_mask;
+    struct io_uring_sqe *sqe = &u->sqes[idx];
+    memset(sqe, 0, sizeof(*sqe));
+    u->sq_array[idx] = idx;
+    __atomic_store_n(u->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    u->to_submit++;
+    return sqe;
+}
+
+/* Plain read/write loop for kernels without io_uring */
+static int tee_multi_buffered(const int fds[], int n) {
+    char buf[BUF_SIZE];
+    ssize_t r;
+    while ((r = read(STDIN_FILENO, buf, sizeof(buf))) > 0) {
+        for (int i = 0; i < n; ++i)
+            if (file_ops_full_write(fds[i], buf, (size_t)r) == -1)
+                return -1;
+    }
+    return r < 0 ? -1 : 0;
+}
+
+/* user_data of a write: chunk slot in the low 16 bits, sink above */
+static uint64_t pack(int slot, int sink) {
+    return (uint64_t)sink << 16 | (uint64_t)slot;
+}
+
+static int queue_write(struct uring *u, struct sink *s, int sink_idx, struct chunk *c,
+                       int slot, size_t done, int fixed) {
+    struct io_uring_sqe *sqe = uring_get_sqe(u);
+    if (!sqe)
+        return -1;
+    sqe->opcode = fixed ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE;
+    sqe->fd = s->fd;
+    sqe->addr = (uint64_t)(uintptr_t)(c->data + done);
+    sqe->len = (unsigned)(c->len - done);
+    if (s->ordered)
+        sqe->off = (u->features & IORING_FEAT_RW_CUR_POS) ? (uint64_t)-1 : 0;
+    else
+        sqe->off = (uint64_t)(s->base + c->offset + (long long)done);
+    if (fixed)
+        sqe->buf_index = (uint16_t)slot;
+    sqe->user_data = pack(slot, sink_idx);
+    s->inflight++;
+    return 0;
+}
+
+static int tee_multi_uring(struct uring *u, struct sink sinks[], int n, char *mem,
+                           size_t chunk_size, int fixed, long long *total) {
+    struct chunk chunks[URING_CHUNKS];
+    for (int i = 0; i < URING_CHUNKS; ++i) {
+        chunks[i].data = mem + (size_t)i * chunk_size;
+        chunks[i].refs = 0;
+    }
+    long long produced = 0;     /* chunks read so far */
+    long long stream_pos = 0;
+    int eof = 0, failed = 0;
+    int outstanding = 0;        /* chunks some sink still has to write */
+    int inflight = 0;           /* writes the kernel has not completed */
+    int stalled = 0;            /* io_uring_enter() failed, nothing reaped since */
+
+    /* after a failure, only wait for the writes in flight to finish */
+    while (failed ? inflight > 0 : !eof || outstanding) {
+        /* read into the next slot once all sinks are done with it */
+        struct chunk *c = &chunks[produced % URING_CHUNKS];
+        if (!failed && !eof && c->refs == 0) {
+            ssize_t r = read(STDIN_FILENO, c->data, chunk_size);
+            if (r < 0 && errno == EINTR)
+                continue;
+            if (r < 0) {
+                failed = 1;
+                continue;
+            }
+            if (r == 0) {
+                eof = 1;
+            } else {
+                c->len = (size_t)r;
+                c->offset = stream_pos;
+                c->refs = n;
+                stream_pos += r;
+                produced++;
+                outstanding++;
+            }
+        }
+
+        /* queue every chunk a sink is allowed to write now, as one batch */
+        for (int i = 0; i < n && !failed; ++i) {
+            struct sink *s = &sinks[i];
+            while (s->next < produced && (!s->ordered || s->inflight == 0)) {
+                int slot = (int)(s->next % URING_CHUNKS);
+                if (queue_write(u, s, i, &chunks[slot], slot, 0, fixed) == -1) {
+                    failed = 1;
+                    break;
+                }
+                s->next++;
+                inflight++;
+            }
+        }
+
+        /* block for completions only if we cannot read ahead */
+        int must_wait = failed || eof || chunks[produced % URING_CHUNKS].refs != 0;
+        /* the kernel may still be writing from our chunks, so a failed
+         * enter only stops queueing; completions already posted are reaped
+         * below. Failing again without reaping anything means the ring is
+         * unusable: the chunks must not be reused or freed then. */
+        if (uring_enter(u, must_wait && inflight ? 1 : 0) == -1) {
+            if (stalled) {
+                u->broken = inflight > (int)u->to_submit;  /* some reached the kernel */
+                return -1;
+            }
+            stalled = failed = 1;
+        } else {
+            stalled = 0;
+        }
+
+        unsigned head = *u->cq_head;
+        unsigned tail = __atomic_load_n(u->cq_tail, __ATOMIC_ACQUIRE);
+        for (; head != tail; ++head) {
+            struct io_uring_cqe *cqe = &u->cqes[head & *u->cq_mask];
+            int slot = (int)(cqe->user_data & 0xffff);
+            struct sink *s = &sinks[cqe->user_data >> 16];
+            struct chunk *ch = &chunks[slot];
+            s->inflight--;
+            inflight--;
+            if (cqe->res <= 0) {
+                errno = cqe->res ? -cqe->res : EIO;
+                failed = 1;
+                continue;
+            }
+            METRIC_INC(CNT_FILE_WRITES);
+            METRIC_ADD(CNT_FILE_BYTES_WRITTEN, cqe->res);
+            s->done[slot] += (size_t)cqe->res;
+            if (s->done[slot] < ch->len) {
+                /* short write: queue the rest right away, an ordered sink
+                 * keeps its single slot */
+                if (failed || queue_write(u, s, (int)(cqe->user_data >> 16), ch, slot,
+                                          s->done[slot], fixed) == -1)
+                    failed = 1;
+                else
+                    inflight++;
+                continue;
+            }
+            s->done[slot] = 0;
+            if (--ch->refs == 0)
+                outstanding--;
+        }
+        if (head != *u->cq_head)
+            stalled = 0;
+        __atomic_store_n(u->cq_head, head, __ATOMIC_RELEASE);
+    }
+    *total = stream_pos;
+    return failed ? -1 : 0;
+}
+
+int tee_multi(const char *const output_files[], int n_files) {
+    if (n_files < 0 || (n_files && !output_files))
+        return -1;
+
+    int n = n_files + 1;
+    int *fds = malloc((size_t)n * sizeof(*fds));
+    struct sink *sinks = calloc((size_t)n, sizeof(*sinks));
+    if (!fds || !sinks) {
+        free(fds);
+        free(sinks);
+        return -1;
+    }
+    fds[0] = STDOUT_FILENO;
+    int opened = 1, ret = -1;
+    for (; opened < n; ++opened) {
+        fds[opened] = open(output_files[opened - 1], O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fds[opened] == -1)
+            goto out;
+    }
+
+    struct uring u;
+    unsigned entries = 1;
+    while (entries < (unsigned)(URING_CHUNKS * n) && entries < 4096)
+        entries <<= 1;
+    if (uring_setup(&u, entries) == -1) {
+        ret = tee_multi_buffered(fds, n);
+        goto out;
+    }
+
+    size_t chunk_size = file_ops_buffer_size(URING_CHUNK_SIZE);
+    char *mem = NULL;
+    if (posix_memalign((void **)&mem, 4096, (size_t)URING_CHUNKS * chunk_size)) {
+        uring_free(&u);
+        goto out;
+    }
+    struct iovec iov[URING_CHUNKS];
+    for (int i = 0; i < URING_CHUNKS; ++i) {
+        iov[i].iov_base = mem + (size_t)i * chunk_size;
+        iov[i].iov_len = chunk_size;
+    }
+    /* pinned buffers save the kernel a page walk per write; RLIMIT_MEMLOCK
+     * may forbid them, then plain writes do */
+    int fixed = syscall(__NR_io_uring_register, u.fd, IORING_REGISTER_BUFFERS,
+                        iov, URING_CHUNKS) == 0;
+
+    for (int i = 0; i < n; ++i) {
+        sinks[i].fd = fds[i];
+        off_t pos = lseek(fds[i], 0, SEEK_CUR);
+        int flags = fcntl(fds[i], F_GETFL);
+        sinks[i].ordered = pos == -1 || flags == -1 || (flags & O_APPEND);
+        sinks[i].base = pos == -1 ? 0 : pos;
+    }
+    long long total = 0;
+    ret = tee_multi_uring(&u, sinks, n, mem, chunk_size, fixed, &total);
+
+    /* positional writes leave the offset of stdout alone; move it where a
+     * sequential writer would have left it */
+    if (ret == 0 && !sinks[0].ordered &&
+        lseek(STDOUT_FILENO, (off_t)(sinks[0].base + total), SEEK_SET) == -1)
+        ret = -1;
+    uring_free(&u);
+    /* leaked rather than handed back to malloc while the kernel may still
+     * read from it */
+    if (!u.broken)
+        free(mem);
+
+out:
+    for (int i = 1; i < opened; ++i)
+        if (close(fds[i]) == -1)
+            ret = -1;
+    free(fds);
+    free(sinks);
+    return ret;
+}
@@ -1,6 +1,7 @@
 #include <sys/mman.h>
 #include "buffer_ring.h"
 #include <stdlib.h>
+#include "../metrics/metrics.h"
 
 struct BufferRing *init_buffer_ring(int size) {
 	
@@ -36,7 +37,10 @@ void free_buffer_ring(struct BufferRing *br) {
 }
 
 int buffer_ring_read(struct BufferRing *br) {
+	METRIC_TIMER(t0);
 	sem_wait(&br->items);
+	METRIC_ELAPSED(HIST_RING_WAIT_NS, t0);
+	METRIC_INC(CNT_RING_READS);
 	sem_wait(&br->mutex);
 	
 	int val = br->buffer[br->idx_reader];
@@ -50,7 +54,10 @@ int buffer_ring_read(struct BufferRing *br) {
 
 void buffer_ring_write(struct BufferRing *br, int value) {
 	
+	METRIC_TIMER(t0);
 	sem_wait(&br->slots);
+	METRIC_ELAPSED(HIST_RING_WAIT_NS, t0);
+	METRIC_INC(CNT_RING_WRITES);
 	sem_wait(&br->mutex);
 	
 	br->buffer[br->idx_writer] = value;
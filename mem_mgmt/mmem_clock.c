@@ -1,6 +1,7 @@
 // mmem_clock.c
 #include "mmem_clock.h"     // stud_clock_* prototypes :contentReference[oaicite:3]{index=3}
 #include <stdlib.h>
+#include "../metrics/metrics.h"
 
 memory* stud_clock_init_list() {
     memory* mem = malloc(sizeof(memory));
@@ -28,6 +29,7 @@ void stud_clock_map_page(memory* mem, uint64_t virtual_address) {
 
     if (!mem->is_full) {
         // still free slots: load at ‘last’
+        METRIC_INC(CNT_PAGE_FAULTS);
         load_page(virtual_address);                           // :contentReference[oaicite:4]{index=4}
         mem->pages[mem->last].virtual_address = virtual_address;
         mem->pages[mem->last].referenced      = true;         // difference from lecture
@@ -38,10 +40,13 @@ void stud_clock_map_page(memory* mem, uint64_t virtual_address) {
         // full: find a victim via clock hand
         while (mem->pages[mem->first].referenced) {
             mem->pages[mem->first].referenced = false;
+            METRIC_INC(CNT_CLOCK_SCANS);
             mem->first = (mem->first + 1) % NO_PAGE_FRAMES;
         }
         // evict victim at ‘first’
+        METRIC_INC(CNT_PAGE_EVICTIONS);
         evict_page(mem->pages[mem->first].virtual_address);    // :contentReference[oaicite:5]{index=5}
+        METRIC_INC(CNT_PAGE_FAULTS);
         load_page(virtual_address);
         mem->pages[mem->first].virtual_address = virtual_address;
         mem->pages[mem->first].referenced      = true;
@@ -57,6 +62,7 @@ void stud_clock_access_page(memory* mem, uint64_t virtual_address) {
     for (int i = 0; i < NO_PAGE_FRAMES; i++) {
         if (mem->pages[i].virtual_address == virtual_address) {
             mem->pages[i].referenced = true;
+            METRIC_INC(CNT_PAGE_HITS);
             return;
         }
     }
@@ -1,6 +1,7 @@
 // mmem_fifo.c
 #include "mmem_fifo.h"      // stud_fifo_* prototypes :contentReference[oaicite:0]{index=0}
 #include <stdlib.h>
+#include "../metrics/metrics.h"
 
 memory* stud_fifo_init_list() {
     memory* mem = malloc(sizeof(memory));
@@ -26,6 +27,7 @@ void stud_fifo_map_page(memory* mem, uint64_t virtual_address) {
 
     if (!mem->is_full) {
         // still free slots: load at ‘last’
+        METRIC_INC(CNT_PAGE_FAULTS);
         load_page(virtual_address);                           // :contentReference[oaicite:1]{index=1}
         mem->pages[mem->last].virtual_address = virtual_address;
         mem->last = (mem->last + 1) % NO_PAGE_FRAMES;
@@ -33,7 +35,9 @@ void stud_fifo_map_page(memory* mem, uint64_t virtual_address) {
             mem->is_full = true;
     } else {
         // full: evict at ‘first’
+        METRIC_INC(CNT_PAGE_EVICTIONS);
         evict_page(mem->pages[mem->first].virtual_address);    // :contentReference[oaicite:2]{index=2}
+        METRIC_INC(CNT_PAGE_FAULTS);
         load_page(virtual_address);
         mem->pages[mem->first].virtual_address = virtual_address;
         // advance both pointers to maintain circular queue
@@ -46,8 +50,10 @@ void stud_fifo_access_page(memory* mem, uint64_t virtual_address) {
     if (!mem || virtual_address == 0) return;
     // hit?
     for (int i = 0; i < NO_PAGE_FRAMES; i++) {
-        if (mem->pages[i].virtual_address == virtual_address)
+        if (mem->pages[i].virtual_address == virtual_address) {
+            METRIC_INC(CNT_PAGE_HITS);
             return;
+        }
     }
     // miss → map it
     stud_fifo_map_page(mem, virtual_address);
@@ -0,0 +1,228 @@
+#ifdef METRICS
+
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "metrics.h"
+
+__thread struct metrics_shard *metrics_tls;
+
+static struct metrics_shard *shards;      /* every shard ever created */
+static pthread_key_t exit_key;
+static pthread_once_t exit_once = PTHREAD_ONCE_INIT;
+
+static const char *const counter_names[N_COUNTERS] = {
+    [CNT_RING_READS]         = "ring.reads",
+    [CNT_RING_WRITES]        = "ring.writes",
+    [CNT_PAGE_HITS]          = "mem.page_hits",
+    [CNT_PAGE_FAULTS]        = "mem.page_faults",
+    [CNT_PAGE_EVICTIONS]     = "mem.page_evictions",
+    [CNT_CLOCK_SCANS]        = "mem.clock_scans",
+    [CNT_CONTEXT_SWITCHES]   = "sched.context_switches",
+    [CNT_PREEMPTIONS]        = "sched.preemptions",
+    [CNT_MIGRATIONS]         = "sched.migrations",
+    [CNT_DISK_REQUESTS]      = "disk.requests",
+    [CNT_DISK_CYLINDERS]     = "disk.cylinders",
+    [CNT_IRQS]               = "irq.interrupts",
+    [CNT_IRQ_POOL_EXHAUSTED] = "irq.pool_exhausted",
+    [CNT_IRQ_BYTES_COPIED]   = "irq.bytes_copied",
+    [CNT_FILE_WRITES]        = "file.writes",
+    [CNT_FILE_BYTES_WRITTEN] = "file.bytes_written",
+};
+
+static const char *const hist_names[N_HISTS] = {
+    [HIST_RING_WAIT_NS]     = "ring.wait_ns",
+    [HIST_RUNQ_DEPTH]       = "sched.runq_depth",
+    [HIST_DISK_SEEK]        = "disk.seek_cylinders",
+    [HIST_DISK_QUEUE_DEPTH] = "disk.queue_depth",
+    [HIST_ISR_NS]           = "irq.isr_ns",
+    [HIST_IRQ_BATCH]        = "irq.batch",
+    [HIST_FILE_WRITE_NS]    = "file.write_ns",
+};
+
+const char *metric_counter_name(enum metric_counter c) {
+    return counter_names[c];
+}
+
+const char *metric_hist_name(enum metric_hist h) {
+    return hist_names[h];
+}
+
+/* A thread that exits gives its shard back; the counts stay in it */
+static void shard_release(void *arg) {
+    struct metrics_shard *s = arg;
+    __atomic_store_n(&s->in_use, 0, __ATOMIC_RELEASE);
+}
+
+static void exit_key_init(void) {
+    pthread_key_create(&exit_key, shard_release);
+}
+
+/* First metric of a thread: adopt a released shard or map a new one. Not
+ * async-signal-safe (pthread_once, pthread_setspecific). */
+struct metrics_shard *metrics_shard_slow(void) {
+    pthread_once(&exit_once, exit_key_init);
+
+    struct metrics_shard *s;
+    for (s = __atomic_load_n(&shards, __ATOMIC_ACQUIRE); s; s = s->next) {
+        int free_shard = 0;
+        if (__atomic_compare_exchange_n(&s->in_use, &free_shard, 1, 0,
+                                        __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+            break;
+    }
+    if (!s) {
+        s = mmap(NULL, sizeof(*s), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (s == MAP_FAILED)
+            return NULL;
+        s->in_use = 1;
+        s->next = __atomic_load_n(&shards, __ATOMIC_RELAXED);
+        while (!__atomic_compare_exchange_n(&shards, &s->next, s, 1,
+                                            __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+            ;
+    }
+    pthread_setspecific(exit_key, s);
+    metrics_tls = s;
+    return s;
+}
+
+static void hist_merge(struct metric_hist_data *dst, const struct metric_hist_data *src) {
+    dst->count += __atomic_load_n(&src->count, __ATOMIC_RELAXED);
+    dst->sum += __atomic_load_n(&src->sum, __ATOMIC_RELAXED);
+    uint64_t max = __atomic_load_n(&src->max, __ATOMIC_RELAXED);
+    if (max > dst->max)
+        dst->max = max;
+    for (unsigned i = 0; i < HIST_BUCKETS; ++i)
+        dst->buckets[i] += __atomic_load_n(&src->buckets[i], __ATOMIC_RELAXED);
+}
+
+void metrics_snapshot(struct metrics_snapshot *out) {
+    memset(out, 0, sizeof(*out));
+    for (struct metrics_shard *s = __atomic_load_n(&shards, __ATOMIC_ACQUIRE); s; s = s->next) {
+        for (int c = 0; c < N_COUNTERS; ++c)
+            out->counters[c] += __atomic_load_n(&s->counters[c], __ATOMIC_RELAXED);
+        for (int h = 0; h < N_HISTS; ++h)
+            hist_merge(&out->hists[h], &s->hists[h]);
+    }
+}
+
+static uint64_t bucket_upper(unsigned i) {
+    if (i < HIST_SUB)
+        return i;
+    unsigned shift = i / HIST_SUB - 1;
+    uint64_t lo = (uint64_t)(HIST_SUB + i % HIST_SUB) << shift;
+    return lo + ((1ull << shift) - 1);
+}
+
+uint64_t metrics_percentile(const struct metric_hist_data *h, double q) {
+    if (!h->count)
+        return 0;
+    uint64_t rank = (uint64_t)(q * (double)h->count);
+    if (rank >= h->count)
+        rank = h->count - 1;
+    uint64_t seen = 0;
+    for (unsigned i = 0; i < HIST_BUCKETS; ++i) {
+        seen += h->buckets[i];
+        if (seen > rank) {
+            uint64_t v = bucket_upper(i);
+            return v < h->max ? v : h->max;
+        }
+    }
+    return h->max;
+}
+
+/* ----- dump: no stdio, no malloc ----- */
+
+struct out_buf {
+    int fd;
+    size_t len;
+    char data[512];
+};
+
+static void out_flush(struct out_buf *o) {
+    size_t off = 0;
+    while (off < o->len) {
+        ssize_t w = write(o->fd, o->data + off, o->len - off);
+        if (w <= 0)
+            break;
+        off += (size_t)w;
+    }
+    o->len = 0;
+}
+
+static void out_str(struct out_buf *o, const char *s) {
+    for (; *s; ++s) {
+        if (o->len == sizeof(o->data))
+            out_flush(o);
+        o->data[o->len++] = *s;
+    }
+}
+
+static void out_u64(struct out_buf *o, uint64_t v) {
+    char digits[21];
+    int i = sizeof(digits) - 1;
+    digits[i] = '\0';
+    do {
+        digits[--i] = (char)('0' + v % 10);
+        v /= 10;
+    } while (v);
+    out_str(o, digits + i);
+}
+
+void metrics_dump(int fd) {
+    struct out_buf o = { .fd = fd };
+    for (int c = 0; c < N_COUNTERS; ++c) {
+        uint64_t sum = 0;
+        for (struct metrics_shard *s = __atomic_load_n(&shards, __ATOMIC_ACQUIRE); s; s = s->next)
+            sum += __atomic_load_n(&s->counters[c], __ATOMIC_RELAXED);
+        out_str(&o, counter_names[c]);
+        out_str(&o, " ");
+        out_u64(&o, sum);
+        out_str(&o, "\n");
+    }
+
+    static const struct { const char *name; double q; } quantiles[] = {
+        { " p50=", 0.5 }, { " p90=", 0.9 }, { " p99=", 0.99 }, { " p999=", 0.999 },
+    };
+    for (int h = 0; h < N_HISTS; ++h) {
+        struct metric_hist_data merged;
+        memset(&merged, 0, sizeof(merged));
+        for (struct metrics_shard *s = __atomic_load_n(&shards, __ATOMIC_ACQUIRE); s; s = s->next)
+            hist_merge(&merged, &s->hists[h]);
+        out_str(&o, hist_names[h]);
+        out_str(&o, " count=");
+        out_u64(&o, merged.count);
+        if (merged.count) {
+            out_str(&o, " mean=");
+            out_u64(&o, merged.sum / merged.count);
+            for (unsigned i = 0; i < sizeof(quantiles) / sizeof(quantiles[0]); ++i) {
+                out_str(&o, quantiles[i].name);
+                out_u64(&o, metrics_percentile(&merged, quantiles[i].q));
+            }
+            out_str(&o, " max=");
+            out_u64(&o, merged.max);
+        }
+        out_str(&o, "\n");
+    }
+    out_flush(&o);
+}
+
+static void dump_handler(int signo) {
+    (void)signo;
+    int saved_errno = errno;
+    metrics_dump(STDERR_FILENO);
+    errno = saved_errno;
+}
+
+int metrics_dump_on_signal(int signo) {
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = dump_handler;
+    sa.sa_flags = SA_RESTART;
+    sigemptyset(&sa.sa_mask);
+    return sigaction(signo, &sa, NULL);
+}
+
+#endif /* METRICS */
@@ -0,0 +1,159 @@
+#ifndef METRICS_H__
+#define METRICS_H__
+
+/*
+ * Counters and latency histograms shared by all subsystems.
+ *
+ * Every thread updates its own shard with plain stores: no locked
+ * instructions and no shared cache lines on the hot path. Readers add the
+ * shards up. Shards of exited threads are handed to new threads, so the
+ * totals only ever grow. Forked children count in their own copy.
+ *
+ * The METRIC_* macros must not be used in signal handlers: the first
+ * metric of a thread sets up its shard with pthread calls, and a handler
+ * bumping a counter its own thread was bumping would lose one of the
+ * updates. metrics_dump() is the only function meant for a handler.
+ *
+ * Build with -DMETRICS and ../metrics/metrics.c. Without METRICS the
+ * METRIC_* macros expand to ((void)0) and nothing needs to be linked, so
+ * instrumented files include this header unconditionally.
+ */
+
+#ifdef METRICS
+
+#include <stdint.h>
+#include <time.h>
+
+enum metric_counter {
+    CNT_RING_READS,             /* ipc: buffer_ring_read calls */
+    CNT_RING_WRITES,            /* ipc: buffer_ring_write calls */
+    CNT_PAGE_HITS,              /* mem: accesses to a loaded page */
+    CNT_PAGE_FAULTS,            /* mem: load_page calls */
+    CNT_PAGE_EVICTIONS,         /* mem: evict_page calls */
+    CNT_CLOCK_SCANS,            /* mem: referenced bits cleared by the hand */
+    CNT_CONTEXT_SWITCHES,       /* sched: tasks elected to RUNNING */
+    CNT_PREEMPTIONS,            /* sched: quantum expired or higher priority */
+    CNT_MIGRATIONS,             /* sched: tasks stolen by another CPU */
+    CNT_DISK_REQUESTS,          /* disk: requests served */
+    CNT_DISK_CYLINDERS,         /* disk: total seek distance */
+    CNT_IRQS,                   /* irq: ISR invocations */
+    CNT_IRQ_POOL_EXHAUSTED,     /* irq: interrupts dropped, no free buffer */
+    CNT_IRQ_BYTES_COPIED,       /* irq: device buffer bytes copied */
+    CNT_FILE_WRITES,            /* file: write, pwrite and io_uring writes */
+    CNT_FILE_BYTES_WRITTEN,     /* file: bytes written, mmap stores included */
+    N_COUNTERS
+};
+
+enum metric_hist {
+    HIST_RING_WAIT_NS,          /* ipc: time blocked on a slot or an item */
+    HIST_RUNQ_DEPTH,            /* sched: tasks queued when one is elected */
+    HIST_DISK_SEEK,             /* disk: cylinders per head movement */
+    HIST_DISK_QUEUE_DEPTH,      /* disk: requests pending at each dispatch */
+    HIST_ISR_NS,                /* irq: time spent in the ISR */
+    HIST_IRQ_BATCH,             /* irq: buffers per upper-half hand-off */
+    HIST_FILE_WRITE_NS,         /* file: latency of one buffer written */
+    N_HISTS
+};
+
+/* HDR-style log-linear buckets: values below 16 are exact, above that each
+ * power of two is split into 16 buckets (at most 6.25% relative error) */
+#define HIST_SUB_BITS 4
+#define HIST_SUB      (1u << HIST_SUB_BITS)
+#define HIST_BUCKETS  ((64 - HIST_SUB_BITS + 1) * HIST_SUB)
+
+struct metric_hist_data {
+    uint64_t count, sum, max;
+    uint64_t buckets[HIST_BUCKETS];
+};
+
+struct metrics_shard {
+    uint64_t counters[N_COUNTERS];
+    struct metric_hist_data hists[N_HISTS];
+    struct metrics_shard *next;
+    int in_use;
+};
+
+struct metrics_snapshot {
+    uint64_t counters[N_COUNTERS];
+    struct metric_hist_data hists[N_HISTS];
+};
+
+/* Sums all shards into out */
+void metrics_snapshot(struct metrics_snapshot *out);
+
+/* Value at quantile q (0 .. 1) of a histogram: the upper bound of its
+ * bucket, at most the largest value recorded */
+uint64_t metrics_percentile(const struct metric_hist_data *h, double q);
+
+const char *metric_counter_name(enum metric_counter c);
+const char *metric_hist_name(enum metric_hist h);
+
+/* Writes every counter and a percentile line per histogram to fd. Uses
+ * only write(2) and the stack, so it may run in a signal handler. */
+void metrics_dump(int fd);
+
+/* Dumps to stderr whenever signo arrives; returns -1 if sigaction fails */
+int metrics_dump_on_signal(int signo);
+
+extern __thread struct metrics_shard *metrics_tls;
+struct metrics_shard *metrics_shard_slow(void);
+
+static inline struct metrics_shard *metrics_shard(void) {
+    struct metrics_shard *s = metrics_tls;
+    return s ? s : metrics_shard_slow();
+}
+
+/* Only the owning thread writes a shard, and never from a signal handler;
+ * the relaxed store keeps readers from seeing a torn value */
+static inline void metric_bump(uint64_t *p, uint64_t n) {
+    __atomic_store_n(p, __atomic_load_n(p, __ATOMIC_RELAXED) + n, __ATOMIC_RELAXED);
+}
+
+static inline unsigned metric_bucket(uint64_t v) {
+    if (v < HIST_SUB)
+        return (unsigned)v;
+    unsigned shift = 63u - (unsigned)__builtin_clzll(v) - HIST_SUB_BITS;
+    return (shift + 1) * HIST_SUB + (unsigned)((v >> shift) & (HIST_SUB - 1));
+}
+
+static inline void metric_add(enum metric_counter c, uint64_t n) {
+    struct metrics_shard *s = metrics_shard();
+    if (s)
+        metric_bump(&s->counters[c], n);
+}
+
+static inline void metric_record(enum metric_hist h, uint64_t v) {
+    struct metrics_shard *s = metrics_shard();
+    if (!s)
+        return;
+    struct metric_hist_data *d = &s->hists[h];
+    metric_bump(&d->count, 1);
+    metric_bump(&d->sum, v);
+    metric_bump(&d->buckets[metric_bucket(v)], 1);
+    if (v > d->max)
+        __atomic_store_n(&d->max, v, __ATOMIC_RELAXED);
+}
+
+static inline uint64_t metrics_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+#define METRIC_ADD(c, n)        metric_add((c), (uint64_t)(n))
+#define METRIC_INC(c)           metric_add((c), 1)
+#define METRIC_RECORD(h, v)     metric_record((h), (uint64_t)(v))
+#define METRIC_TIMER(t)         uint64_t t = metrics_now_ns()
+#define METRIC_ELAPSED(h, t)    metric_record((h), metrics_now_ns() - (t))
+
+#else
+
+#define METRIC_ADD(c, n)        ((void)0)
+#define METRIC_INC(c)           ((void)0)
+#define METRIC_RECORD(h, v)     ((void)0)
+#define METRIC_TIMER(t)         ((void)0)
+#define METRIC_ELAPSED(h, t)    ((void)0)
+
+#endif /* METRICS */
+
+#endif /* METRICS_H__ */